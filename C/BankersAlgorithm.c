@@ -1,57 +1,754 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define MATRIX_ALIGNMENT 64 // The byte alignment of every matrix and vector (one cache line).
+#define ROW_BLOCK 8 // The number of ints each row is padded to a multiple of (one AVX2 register).
 
 int resourceCount; // The number of resources allocated.
 int processCount; // The number of processes allocated.
+int rowStride; // The padded length of each matrix row and resource vector.
+int processCapacity; // The number of process rows the matrices and per-process arrays have room for.
 
 int* resources; // Array representing the total qty of each resource.
 int* available; // Array representing the available qty of each resource.
 
-int** maxClaim; // The max number of each resource (column) each process (row) will need.
-int** allocated; // The current number of each resource (column) each process (row) is using.
-int** needed; // The current number of each resource (column) each process (row) still needs.
+// Each matrix is stored flat and row-major, one row of rowStride ints per process, with the padding zeroed.
+int* maxClaim; // The max number of each resource (column) each process (row) will need.
+int* allocated; // The current number of each resource (column) each process (row) is using.
+int* needed; // The current number of each resource (column) each process (row) still needs.
+
+#define REPORT_SILENT 0 // Report nothing from the tables and solvers.
+#define REPORT_SUMMARY 1 // Report tables, verdicts and sequences.
+#define REPORT_TRACE 2 // Also report every process check the greedy solver makes.
+#define REPORT_FLUSH_SIZE 65536 // The number of buffered bytes that triggers a write to stdout.
+
+struct ReportBuffer // One reusable output buffer, written out whenever it passes REPORT_FLUSH_SIZE
+{
+    char* data;
+    size_t length;
+    size_t capacity;
+};
+
+struct ReportBuffer report; // The buffer every table and solver trace is streamed into.
+int reportVerbosity = REPORT_TRACE; // How much is reported (one of REPORT_*).
+
+#define SOLVER_GREEDY 0 // Re-sweep every unfinished process until a pass sequences nobody.
+#define SOLVER_EVENT_DRIVEN 1 // Only revisit processes whose blocking resources were just released.
+#define SOLVER_PARALLEL 2 // Split each sweep across worker threads and merge their releases between sweeps.
+#define SOLVER_SPARSE 3 // Run the event-driven solver over a compressed copy holding only non-zero entries.
+#define SOLVER_FIXED_WIDTH 4 // Sweep with a kernel built for 4-16 resources, packing each row into one or two registers.
+#define SOLVER_LAST SOLVER_FIXED_WIDTH // The highest SOLVER_* mode.
+int solverMode; // The solver FindSafeSequence runs (one of SOLVER_*).
+const char* solverNames[] = {"greedy", "event-driven", "parallel", "sparse", "fixed-width"}; // A label for each SOLVER_* mode.
+
+struct SolverStats // Counters and timers the solvers add to as they run
+{
+    long long solves; // How many solves have run.
+    long long passes; // How many sweeps checked an unfinished process, counting one that found nobody (one scan for the event-driven solvers).
+    long long processChecks; // How many times a process was tested against the available resources.
+    long long resourceComparisons; // How many resource counts those tests compared, stopping at the first short one.
+    long long earlyExits; // How many tests found a short resource before the last one.
+    long long releases; // How many finished processes handed their allocation back.
+    double checkSeconds; // Time spent testing processes (including sorting, for the event-driven solvers).
+    double releaseSeconds; // Time spent handing allocations back (and re-testing whoever that unblocked).
+    long long peakScratchBytes; // The most working memory any one solve allocated.
+};
+
+struct SolverStats solverStats; // The running totals since they were last reset.
+int solverTiming = 1; // Whether the solvers time their phases (the sweeping solvers read the clock around every release).
+int workerCount; // The number of threads the parallel solver uses (0 = one per online core).
+
+struct ParallelSolve // The state shared by every thread of one parallel solve
+{
+    const int* demand; // The matrix each process is checked against.
+    int* work; // The available resources, only written by the coordinator between sweeps.
+    int* pending; // The unfinished processes, compacted after every sweep.
+    int pendingCount; // The number of entries in pending.
+    unsigned char* finishedNow; // Whether each pending slot was sequenced during this sweep.
+    int* partials; // One release total per thread (threadCount rows of rowStride), merged after each sweep.
+    struct SolverStats* threadStats; // One set of check counters per thread, merged once the solve ends.
+    int threadCount; // The number of threads scanning, the coordinator included.
+    int isDone; // Set by the coordinator once a sweep sequences nobody or nobody is left.
+    pthread_barrier_t sweepStart; // Released once the next sweep may begin.
+    pthread_barrier_t sweepEnd; // Released once every thread has scanned its slice.
+};
+
+struct ParallelWorker // The arguments of one worker thread
+{
+    struct ParallelSolve* solve;
+    int threadIndex;
+};
+
+#define REQUEST_GRANTED 0 // The request was granted and the state is still safe.
+#define REQUEST_INVALID 1 // The process index or a resource count was out of range.
+#define REQUEST_EXCEEDS_CLAIM 2 // The process asked for more than its remaining claim.
+#define REQUEST_MUST_WAIT 3 // Not enough of some resource is available right now.
+#define REQUEST_UNSAFE 4 // Granting the request would leave the state unsafe.
+#define REQUEST_NOT_SAVED 5 // The change was undone because its journal record couldn't be written.
+#define REQUEST_LAST REQUEST_NOT_SAVED // The highest REQUEST_* code.
+
+int* safeSequence; // The last safe sequence found for the current state (when safeSequenceValid).
+int* sequencePosition; // The position of each process within safeSequence.
+int* candidateSequence; // Scratch space for a solve that may or may not replace safeSequence.
+int* requestWork; // Scratch available vector for re-checking a sequence.
+int* sweepWork; // Scratch available vector for the greedy solver.
+unsigned char* sweepCompleted; // Scratch completed flags for the greedy solver.
+int safeSequenceValid; // Whether safeSequence is known to be safe for the current state.
+const char* requestMessages[] = { // A description of each REQUEST_* code.
+    "granted",
+    "rejected: invalid process or resource counts",
+    "rejected: exceeds the process's remaining claim",
+    "must wait: not enough resources available",
+    "denied: the resulting state would be unsafe",
+    "failed: the change could not be saved to disk"
+};
+
+int* requested; // The outstanding request of each resource (column) each process (row) is blocked on.
+int* detectionSequence; // The order processes could finish in at the last deadlock detection.
+int* detectionPosition; // The position of each process in detectionSequence, or -1 if it couldn't finish.
+int* detectionWork; // The available resources once every process in detectionSequence has finished.
+int* detectionWaiters; // The first process (plus one) that couldn't finish waiting on each resource, or 0.
+int* detectionNextWaiter; // The next process (plus one) waiting on the same resource as each one, or 0.
+int* detectionWaitingOn; // The resource each process that couldn't finish is waiting on.
+int detectionFinished; // How many processes could finish at the last deadlock detection.
+int detectionValid; // Whether the last deadlock detection still matches the current state.
+
+#define SEARCH_PROCESS_LIMIT 64 // The most processes the subset search handles (one bit of a completed set each).
+#define SEARCH_TABLE_LIMIT (1LL << 24) // The most completed sets the subset search will remember.
+#define SEARCH_SLOT_USED 1 // The slot holds a completed set.
+#define SEARCH_COUNT_KNOWN 2 // The slot's count of safe completions is filled in.
+#define SEARCH_STEPS_KNOWN 4 // The slot's fewest steps to the targets is filled in.
+
+struct SearchTable // An open-addressed memo from completed-process sets (bitmasks) to what's known about them
+{
+    unsigned long long* keys; // The completed set in each slot.
+    unsigned long long* counts; // How many safe orders can finish everyone else (saturating).
+    int* steps; // The fewest further processes to run until every target has finished.
+    unsigned char* flags; // SEARCH_* bits saying whether the slot is used and which fields are filled in.
+    long long capacity; // A power of two.
+    long long used;
+    int isFull; // Set once SEARCH_TABLE_LIMIT stopped the search; its results are then incomplete.
+};
+
+struct SparseMatrix // A matrix compressed by row (CSR), keeping only its non-zero entries
+{
+    int rowCount;
+    long long* rowStart; // Where each row's entries start (rowCount + 1 entries).
+    int* columns; // The resource of each entry.
+    int* values; // The value of each entry.
+};
+
+struct SparseState // A whole state whose memory scales with its non-zero entries (maxClaim is allocated + needed)
+{
+    int processCount;
+    int resourceCount;
+    int* available; // The available qty of each resource.
+    struct SparseMatrix allocated; // The non-zero current use of each process.
+    struct SparseMatrix needed; // The non-zero remaining need of each process.
+};
+
+#define STATE_SAFE 0 // A generated state with a safe sequence.
+#define STATE_UNSAFE 1 // A generated state where one process can never finish.
+#define STATE_ADVERSARIAL 2 // A generated safe state where each greedy sweep finishes only one process.
+const char* stateKindNames[] = {"safe", "unsafe", "adversarial"}; // A label for each STATE_* kind.
+
+#define STATE_FILE_MAGIC "BNKR" // The first four bytes of a binary state file.
+#define STATE_FILE_VERSION 1 // The binary state file layout written by SaveStateFile.
+
+struct StateFileHeader // The start of a binary state file, followed by resources, maxClaim then allocated (unpadded)
+{
+    char magic[4]; // Always STATE_FILE_MAGIC.
+    int version; // Always STATE_FILE_VERSION.
+    int processCount;
+    int resourceCount;
+};
+
+struct LoadedState // A state file parsed into its own buffers, only swapped into the globals once it's all been accepted
+{
+    int processCount;
+    int resourceCount;
+    int* resources; // The units of each resource.
+    int* maxClaim; // processCount unpadded rows.
+    int* allocated; // processCount unpadded rows.
+};
+
+#define SCENARIO_REQUEST 0 // One process asks for more of each resource.
+#define SCENARIO_AVAILABLE 1 // The available vector shifts by a (possibly negative) delta.
+
+struct Scenario // One hypothetical change to the current state
+{
+    int type; // One of SCENARIO_*.
+    int processIndex; // The requesting process (SCENARIO_REQUEST only).
+    const int* delta; // The request or available change, resourceCount values.
+};
+
+struct ScenarioBatch // The state shared by every thread of one what-if batch
+{
+    const struct Scenario* scenarios;
+    int scenarioCount;
+    int* verdicts; // One REQUEST_* code per scenario.
+    atomic_int nextScenario; // The next scenario a thread should claim.
+};
+
+#define JOURNAL_MAGIC "BNKJ" // The first four bytes of a journal file.
+#define JOURNAL_REQUEST 0 // A granted request.
+#define JOURNAL_RELEASE 1 // A release.
+#define JOURNAL_ADD_PROCESS 2 // A process added with nothing allocated; the values are its max claim.
+#define JOURNAL_REMOVE_PROCESS 3 // A process removed, the last process taking its index; the values are unused.
+#define JOURNAL_ADD_RESOURCE 4 // A resource type added; the values are every resource's units, the new one included.
+#define JOURNAL_SET_MAX 5 // A process's max claim replaced.
+#define JOURNAL_SET_ALLOCATED 6 // A process's allocation replaced, the difference coming from or going to available.
+#define JOURNAL_CHECKPOINT_RECORDS 100000 // The number of journal records that triggers a fresh checkpoint.
+
+struct JournalHeader // The start of a journal file, followed by records
+{
+    char magic[4]; // Always JOURNAL_MAGIC.
+    int generation; // The checkpoint this journal continues from.
+    int resourceCount; // The number of values after each record.
+};
+
+struct JournalRecord // One change to the state, followed by resourceCount values (one more for JOURNAL_ADD_RESOURCE)
+{
+    int operation; // One of JOURNAL_*.
+    int processIndex;
+    unsigned int checksum; // Of the operation, process and values, so a torn final record is spotted.
+};
+
+struct Persistence // The on-disk copy of the state: checkpoint.<generation> plus the changes since in journal.<generation>
+{
+    int isOpen;
+    char directory[900];
+    int generation; // The newest complete checkpoint (0 before the first one).
+    int journal; // The open journal file (-1 before the first checkpoint).
+    int lock; // The lock file held so only one process uses the directory.
+    char* pending; // Records appended since the last commit.
+    size_t pendingSize;
+    size_t pendingCapacity;
+    long long recordCount; // How many records the journal holds.
+    off_t journalSize; // How many bytes of the journal are known to be on disk.
+    int isTorn; // Set if a failed write may have left part of a record behind, so the next commit checkpoints instead.
+    long long commitCount; // How many times the journal has been synced.
+};
+struct Persistence persistence; // Where the state is kept (when persistence.isOpen).
+
+struct ResourceManager // Lets many threads request and release against the global state at once
+{
+    pthread_mutex_t lock; // Held while a request or release is decided and applied.
+    atomic_uint version; // Bumped before and after every publish, so it's odd while one is under way (a seqlock).
+    atomic_int* snapshot; // The available vector as last published (resourceCount values).
+    int isOpen;
+};
+struct ResourceManager manager; // The manager over the global state (when manager.isOpen).
+
+struct StressWorker // The arguments and results of one stress benchmark thread
+{
+    pthread_t thread;
+    int threadIndex; // This thread owns every process whose index is threadIndex mod threadCount.
+    int threadCount;
+    int operations;
+    double* latencies; // How long each operation took, in seconds.
+    long long outcomes[REQUEST_LAST + 1]; // How many operations ended with each REQUEST_* code.
+    long long snapshotRetries; // How many snapshot reads raced a publish and had to start over.
+};
+
+#define DAEMON_OP_REQUEST 0 // Ask for resources; the values are the request.
+#define DAEMON_OP_RELEASE 1 // Give resources back; the values are the release.
+#define DAEMON_OP_DESCRIBE 2 // Ask for the state's size; answered with the status, processCount then resourceCount.
+#define DAEMON_BATCH_LIMIT 256 // The most requests judged by one safety evaluation.
+#define DAEMON_CLIENT_LIMIT 1024 // The most connections served at once.
+#define DAEMON_BUFFER_SIZE 65536 // The fewest bytes of unhandled messages kept per connection (room for 4 messages at least).
+
+struct DaemonHeader // The start of every message, followed by count int32 values; every reply starts with an int32 status
+{
+    int operation; // One of DAEMON_OP_*.
+    int processIndex;
+    int count; // resourceCount for requests and releases, 0 to describe.
+};
+
+struct DaemonClient // One connection to the daemon and the partial messages read from it
+{
+    int socket; // -1 once the connection is closed.
+    int filled; // How many bytes of buffer hold unhandled messages.
+    char* buffer;
+};
+
+struct DaemonBatch // The messages handled since replies were last sent, requests tentatively granted until settled
+{
+    int count;
+    int settled; // How many of the messages have their final result.
+    int clients[DAEMON_BATCH_LIMIT]; // The connection each message came from.
+    int operations[DAEMON_BATCH_LIMIT]; // DAEMON_OP_REQUEST or DAEMON_OP_RELEASE.
+    int processes[DAEMON_BATCH_LIMIT];
+    int results[DAEMON_BATCH_LIMIT]; // The REQUEST_* code each message will be answered with.
+    int* vectors; // One padded row per message.
+    long long batchCount; // How many safety evaluations have judged requests.
+    long long requestCount; // How many requests went through them.
+    long long fallbackCount; // How many batches were unsafe together and were decided one request at a time.
+};
+
+struct DaemonLoadWorker // The arguments and results of one load generator connection
+{
+    pthread_t thread;
+    const char* path;
+    int connectionIndex; // This connection uses every process whose index is connectionIndex mod connectionCount.
+    int connectionCount;
+    int requests;
+    int processCount;
+    int resourceCount;
+    double* latencies; // How long each round trip took, in seconds.
+    long long outcomes[REQUEST_LAST + 1]; // How many round trips ended with each REQUEST_* code.
+    int isFailed; // Whether the connection broke.
+};
+
+volatile sig_atomic_t daemonStopping; // Set by SIGINT or SIGTERM to shut the daemon down.
+
+
+/***************************************************************/
+void* AllocateAligned(size_t size)
+{
+    // Declare variables
+    void* memory;
+
+#ifdef _WIN32
+    memory = _aligned_malloc(size, MATRIX_ALIGNMENT);
+#else
+    if (posix_memalign(&memory, MATRIX_ALIGNMENT, size) != 0) memory = NULL;
+#endif
+
+    return memory;
+}
+
+void FreeAligned(void* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+int* AllocateMatrix(int rows)
+{
+    // Declare variables
+    size_t size = (size_t) rows * rowStride * sizeof(int);
+    int* matrix;
+
+    // Allocate the rows as one aligned block, zeroing the padding columns
+    matrix = AllocateAligned(size);
+    if (matrix != NULL) memset(matrix, 0, size);
+
+    return matrix;
+}
+
+int* MatrixRow(int* matrix, int processIndex)
+{
+    // Find the start of the given process's row
+    return matrix + (size_t) processIndex * rowStride;
+}
+
+int LowestSetBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+int FindShortfall(const int* need, const int* availableRow, int count)
+{
+    // Returns the first resource index where need exceeds what is available, or count if the whole row fits.
+    // Declare variables
+    int resourceIndex = 0;
+    unsigned int mask;
+
+#if defined(__AVX2__)
+    // Compare eight resources at a time
+    for (; resourceIndex + 8 <= count; resourceIndex += 8)
+    {
+        __m256i needBlock = _mm256_loadu_si256((const __m256i*) (need + resourceIndex));
+        __m256i availableBlock = _mm256_loadu_si256((const __m256i*) (availableRow + resourceIndex));
+        mask = (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needBlock, availableBlock)));
+        if (mask) return resourceIndex + LowestSetBit(mask);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Compare four resources at a time
+    for (; resourceIndex + 4 <= count; resourceIndex += 4)
+    {
+        __m128i needBlock = _mm_loadu_si128((const __m128i*) (need + resourceIndex));
+        __m128i availableBlock = _mm_loadu_si128((const __m128i*) (availableRow + resourceIndex));
+        mask = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needBlock, availableBlock)));
+        if (mask) return resourceIndex + LowestSetBit(mask);
+    }
+#endif
+    // Compare whatever is left one at a time
+    for (; resourceIndex < count; resourceIndex++)
+    {
+        if (need[resourceIndex] > availableRow[resourceIndex]) return resourceIndex;
+    }
+
+    return count;
+}
+
+void AddRow(int* target, const int* source, int count)
+{
+    // Declare variables
+    int resourceIndex = 0;
+
+#if defined(__AVX2__)
+    // Add eight resources at a time
+    for (; resourceIndex + 8 <= count; resourceIndex += 8)
+    {
+        __m256i targetBlock = _mm256_loadu_si256((const __m256i*) (target + resourceIndex));
+        __m256i sourceBlock = _mm256_loadu_si256((const __m256i*) (source + resourceIndex));
+        _mm256_storeu_si256((__m256i*) (target + resourceIndex), _mm256_add_epi32(targetBlock, sourceBlock));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Add four resources at a time
+    for (; resourceIndex + 4 <= count; resourceIndex += 4)
+    {
+        __m128i targetBlock = _mm_loadu_si128((const __m128i*) (target + resourceIndex));
+        __m128i sourceBlock = _mm_loadu_si128((const __m128i*) (source + resourceIndex));
+        _mm_storeu_si128((__m128i*) (target + resourceIndex), _mm_add_epi32(targetBlock, sourceBlock));
+    }
+#endif
+    // Add whatever is left one at a time
+    for (; resourceIndex < count; resourceIndex++)
+    {
+        target[resourceIndex] += source[resourceIndex];
+    }
+}
+
+void SubtractRow(int* target, const int* source, int count)
+{
+    // Declare variables
+    int resourceIndex = 0;
+
+#if defined(__AVX2__)
+    // Subtract eight resources at a time
+    for (; resourceIndex + 8 <= count; resourceIndex += 8)
+    {
+        __m256i targetBlock = _mm256_loadu_si256((const __m256i*) (target + resourceIndex));
+        __m256i sourceBlock = _mm256_loadu_si256((const __m256i*) (source + resourceIndex));
+        _mm256_storeu_si256((__m256i*) (target + resourceIndex), _mm256_sub_epi32(targetBlock, sourceBlock));
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Subtract four resources at a time
+    for (; resourceIndex + 4 <= count; resourceIndex += 4)
+    {
+        __m128i targetBlock = _mm_loadu_si128((const __m128i*) (target + resourceIndex));
+        __m128i sourceBlock = _mm_loadu_si128((const __m128i*) (source + resourceIndex));
+        _mm_storeu_si128((__m128i*) (target + resourceIndex), _mm_sub_epi32(targetBlock, sourceBlock));
+    }
+#endif
+    // Subtract whatever is left one at a time
+    for (; resourceIndex < count; resourceIndex++)
+    {
+        target[resourceIndex] -= source[resourceIndex];
+    }
+}
+
+int IsVectorInRange(const int* vector)
+{
+    // Declare variables
+    int resourceIndex;
+
+    // Check nothing is negative
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        if (vector[resourceIndex] < 0) return 0;
+    }
+
+    return 1;
+}
+
+int IsRowEmpty(const int* row)
+{
+    // Declare variables
+    int resourceIndex;
+
+    // Check everything is zero
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        if (row[resourceIndex] != 0) return 0;
+    }
+
+    return 1;
+}
+
+unsigned int NextRandom(unsigned int* state)
+{
+    // Advances a xorshift generator, so generated states are reproducible from their seed.
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+double NowSeconds()
+{
+    // Declare variables
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int WriteAll(int fileDescriptor, const void* data, size_t size)
+{
+    // Writes every byte, retrying short writes; returns whether it all went out.
+    // Declare variables
+    const char* cursor = data;
+    ssize_t written;
+
+    while (size > 0)
+    {
+        written = write(fileDescriptor, cursor, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 0;
+        cursor += written;
+        size -= (size_t) written;
+    }
+
+    return 1;
+}
+
+int ReadAll(int fileDescriptor, void* data, size_t size)
+{
+    // Reads exactly size bytes; returns whether they all arrived.
+    // Declare variables
+    char* cursor = data;
+    ssize_t got;
+
+    while (size > 0)
+    {
+        got = read(fileDescriptor, cursor, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        cursor += got;
+        size -= (size_t) got;
+    }
+
+    return 1;
+}
+
+void FreeState()
+{
+    // Free the vectors and matrices (all safe on NULL)
+    FreeAligned(resources);
+    FreeAligned(available);
+    FreeAligned(maxClaim);
+    FreeAligned(allocated);
+    FreeAligned(needed);
+    FreeAligned(requestWork);
+    FreeAligned(sweepWork);
+    free(sweepCompleted);
+    FreeAligned(requested);
+    FreeAligned(detectionWork);
+    FreeAligned(detectionWaiters);
+    free(detectionSequence);
+    free(detectionPosition);
+    free(detectionNextWaiter);
+    free(detectionWaitingOn);
+    free(safeSequence);
+    free(sequencePosition);
+    free(candidateSequence);
+
+    // Forget the freed pointers so the state can be re-entered
+    resources = NULL;
+    available = NULL;
+    maxClaim = NULL;
+    allocated = NULL;
+    needed = NULL;
+    requestWork = NULL;
+    sweepWork = NULL;
+    sweepCompleted = NULL;
+    requested = NULL;
+    detectionWork = NULL;
+    detectionWaiters = NULL;
+    detectionSequence = NULL;
+    detectionPosition = NULL;
+    detectionNextWaiter = NULL;
+    detectionWaitingOn = NULL;
+    detectionValid = 0;
+    safeSequence = NULL;
+    sequencePosition = NULL;
+    candidateSequence = NULL;
+    safeSequenceValid = 0;
+    processCapacity = 0;
+}
+
+void AllocateState()
+{
+    // Sizes every vector and matrix from processCount and resourceCount, all zeroed.
+    // Release any previously entered state
+    FreeState();
 
+    // Pad each row out to a whole number of vector blocks
+    rowStride = (resourceCount + ROW_BLOCK - 1) / ROW_BLOCK * ROW_BLOCK;
+    processCapacity = processCount;
+
+    // Instantiate each array and matrices
+    resources = AllocateMatrix(1);
+    available = AllocateMatrix(1);
+    maxClaim = AllocateMatrix(processCount);
+    allocated = AllocateMatrix(processCount);
+    needed = AllocateMatrix(processCount);
+
+    // Instantiate the request scratch space
+    requestWork = AllocateMatrix(1);
+    sweepWork = AllocateMatrix(1);
+    sweepCompleted = malloc(processCount);
+
+    // Instantiate the deadlock detection state
+    requested = AllocateMatrix(processCount);
+    detectionWork = AllocateMatrix(1);
+    detectionWaiters = AllocateMatrix(1);
+    detectionSequence = malloc(processCount * sizeof(int));
+    detectionPosition = malloc(processCount * sizeof(int));
+    detectionNextWaiter = malloc(processCount * sizeof(int));
+    detectionWaitingOn = malloc(processCount * sizeof(int));
+    safeSequence = malloc(processCount * sizeof(int));
+    sequencePosition = malloc(processCount * sizeof(int));
+    candidateSequence = malloc(processCount * sizeof(int));
+}
 
 /***************************************************************/
+void ReportFlush()
+{
+    // Write out whatever is buffered
+    if (report.length > 0) fwrite(report.data, 1, report.length, stdout);
+    report.length = 0;
+}
+
+void ReportReserve(size_t extra)
+{
+    // Makes room for extra more bytes, doubling the buffer; it stops growing once it holds a flush's worth.
+    // Declare variables
+    size_t capacity = report.capacity > 0 ? report.capacity : 1024;
+
+    if (report.length + extra <= report.capacity) return;
+    while (capacity < report.length + extra) capacity *= 2;
+    report.data = realloc(report.data, capacity);
+    report.capacity = capacity;
+}
+
+void ReportBytes(const char* text, size_t length)
+{
+    // Append the bytes, flushing once the buffer is full enough
+    ReportReserve(length);
+    memcpy(report.data + report.length, text, length);
+    report.length += length;
+    if (report.length >= REPORT_FLUSH_SIZE) ReportFlush();
+}
+
+void ReportText(const char* text)
+{
+    ReportBytes(text, strlen(text));
+}
+
+void ReportInt(int value)
+{
+    // Formats the integer by hand into a small stack buffer, back to front
+    // Declare variables
+    char digits[12];
+    int position = sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int) value : (unsigned int) value;
+
+    do
+    {
+        digits[--position] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) digits[--position] = '-';
+
+    ReportBytes(digits + position, sizeof(digits) - position);
+}
+
+void ReportRow(const char* separator, const int* row, int count)
+{
+    // Declare variables
+    int resourceIndex;
+
+    // Append each value after the separator
+    for (resourceIndex = 0; resourceIndex < count; resourceIndex++)
+    {
+        ReportText(separator);
+        ReportInt(row[resourceIndex]);
+    }
+}
+
+void ReportRepeat(const char* text, int count)
+{
+    // Append the text count times
+    while (count-- > 0) ReportText(text);
+}
+
 void PrintResources()
 {
     // Declare variables
     int resourceIndex;
 
+    if (reportVerbosity < REPORT_SUMMARY) return;
+
     // Print the table header
-    printf("\n\tUnits\tAvailable\n------------------------\n");
+    ReportText("\n\tUnits\tAvailable\n------------------------\n");
     // Print each row
     for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
     {
-        printf("r%d\t%d\t%d\n", resourceIndex, resources[resourceIndex], available[resourceIndex]);
+        ReportText("r");
+        ReportInt(resourceIndex);
+        ReportText("\t");
+        ReportInt(resources[resourceIndex]);
+        ReportText("\t");
+        ReportInt(available[resourceIndex]);
+        ReportText("\n");
     }
+    ReportFlush();
 }
 
 void PrintProcesses()
 {
     // Declare variables
-    int resourceIndex;
     int processIndex;
     int index;
-    char* printString;
-    char buffer[100];
-    int** table;
+    int* table;
 
-    // Compute how many columns (tabs) we'll need for each category
-    printString = malloc(sizeof(char) * 1024);
-    printString[0] = '\0';
-    for (processIndex = 0; processIndex <= resourceCount; processIndex++)
-        printString = strcat(printString, "\t");
+    if (reportVerbosity < REPORT_SUMMARY) return;
 
-    // Build the upper table header
-    printf("\n\tMax%s%s%s%s", printString, "Current", printString, "Potential\n");
+    // Build the upper table header, with a column (tab) for each resource plus one between categories
+    ReportText("\n\tMax");
+    ReportRepeat("\t", resourceCount + 1);
+    ReportText("Current");
+    ReportRepeat("\t", resourceCount + 1);
+    ReportText("Potential\n");
 
     // Build the lower table header
-    // Start the new line
-    free(printString);
-    printString = malloc(sizeof(char) * 1024);
-    printString[0] = '\0';
     // Construct each block of headers
     for (index = 0; index < 4 * resourceCount; index++)
     {
@@ -59,41 +756,27 @@ void PrintProcesses()
         if (index % 4 == 0)
         {
             // Add a separator
-            printString = strcat(printString, "\t");
+            ReportText("\t");
         }
         else
         {
             // Add a resource-number string and a separator, using modulo to keep proper count of r
-            sprintf(buffer, "r%d\t", index % 4 - 1);
-            strcat(printString, buffer);
+            ReportText("r");
+            ReportInt(index % 4 - 1);
+            ReportText("\t");
         }
     }
-    // Output the lower table header
-    printf(printString);
 
     // Build the divider
-    free(printString);
-    printString = malloc(sizeof(char) * 1024);
-    printString[0] = '\n';
-    printString[1] = '\0';
-    for (processIndex = 0; processIndex <= 8 * 4 * resourceCount + 1; processIndex++)
-        printString = strcat(printString, "-");
-    // Output the divider
-    printf(printString);
+    ReportText("\n");
+    ReportRepeat("-", 8 * 4 * resourceCount + 2);
 
     // Build the table
     for (processIndex = 0; processIndex < processCount; processIndex++)
     {
-        // Start the new line
-        free(printString);
-        printString = malloc(sizeof(char) * 1024);
-        printString[0] = '\0';
         // Append the process number
-        sprintf(buffer, "\np%d", processIndex);
-        strcat(printString, buffer);
-
-        // Update the read table
-        table = maxClaim;
+        ReportText("\np");
+        ReportInt(processIndex);
 
         // Append each column
         for (index = 0; index < 3; index++)
@@ -102,20 +785,13 @@ void PrintProcesses()
             if (index == 1) table = allocated;
             if (index == 2) table = needed;
 
-            // Append each resource column
-            for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
-            {
-                // Shift the tab, then print the value
-                sprintf(buffer, "\t%d", table[processIndex][resourceIndex]);
-                strcat(printString, buffer);
-            }
+            // Shift the tab, then print each value
+            ReportRow("\t", MatrixRow(table, processIndex), resourceCount);
             // Shift the empty column
-            strcat(printString, "\t");
+            ReportText("\t");
         }
-
-        // Print the row and move to the next one
-        printf(printString);
     }
+    ReportFlush();
 }
 
 void TakeParameters()
@@ -167,21 +843,8 @@ void TakeParameters()
     } while (isInputBad);
 
 
-    // Instantiate each array and matrices
-    resources = malloc(resourceCount * sizeof(int));
-    available = malloc(resourceCount * sizeof(int));
-
-    // Instantiate the rows
-    maxClaim = (int**) malloc(processCount * sizeof(int*));
-    allocated = (int**) malloc(processCount * sizeof(int*));
-    needed = (int**) malloc(processCount * sizeof(int*));
-    // Instantiate the columns
-    for (processIndex = 0; processIndex < processCount; processIndex++)
-    {
-        maxClaim[processIndex] = (int*) malloc(resourceCount * sizeof(int));
-        allocated[processIndex] = (int*) malloc(resourceCount * sizeof(int));
-        needed[processIndex] = (int*) malloc(resourceCount * sizeof(int));
-    }
+    // Instantiate each array and matrices, releasing any previously entered state
+    AllocateState();
 
     // Take the max number of each resource
     do
@@ -228,10 +891,10 @@ void TakeParameters()
             for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
             {
                 // Store the max
-                scanf("%d", &maxClaim[processIndex][resourceIndex]);
+                scanf("%d", &MatrixRow(maxClaim, processIndex)[resourceIndex]);
 
                 // Error Checking
-                if (maxClaim[processIndex][resourceIndex] < 0)
+                if (MatrixRow(maxClaim, processIndex)[resourceIndex] < 0)
                 {
                     // Print the error
                     printf("ERROR: Each resource max must be greater than or equal to 0!\n");
@@ -268,14 +931,15 @@ void TakeParameters()
             for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
             {
                 // Store the current allocated resources
-                scanf("%d", &allocated[processIndex][resourceIndex]);
+                scanf("%d", &MatrixRow(allocated, processIndex)[resourceIndex]);
                 // Compute and store the needed resources
-                needed[processIndex][resourceIndex] = maxClaim[processIndex][resourceIndex] - allocated[processIndex][resourceIndex];
+                MatrixRow(needed, processIndex)[resourceIndex] = MatrixRow(maxClaim, processIndex)[resourceIndex]
+                                                                 - MatrixRow(allocated, processIndex)[resourceIndex];
                 // Update the available resources
-                available[resourceIndex] -= allocated[processIndex][resourceIndex];
+                available[resourceIndex] -= MatrixRow(allocated, processIndex)[resourceIndex];
 
                 // Error Checking
-                if (allocated[processIndex][resourceIndex] < 0)
+                if (MatrixRow(allocated, processIndex)[resourceIndex] < 0)
                 {
                     // Print the error
                     printf("ERROR: Each resource use must be greater than or equal to 0!\n");
@@ -305,141 +969,4250 @@ void TakeParameters()
     PrintProcesses();
 }
 
-void FindSafeSequence()
+/***************************************************************/
+int ParseNextInt(const char** cursor, const char* end, int* value)
 {
+    // Reads the next whitespace-separated (optionally negative) integer; returns 0 at the end or on bad input.
     // Declare variables
-    int processIndex;
-    int resourceIndex;
-
-    int* completed;
-    int* availableLocal;
-
-    int allCompleted;
-    int anyCompleted;
-    int canSequence;
+    const char* position = *cursor;
+    int isNegative = 0;
+    long long result = 0;
 
-    char buffer[100];
-    char* printStringA;
-    char* printStringB;
+    // Skip the whitespace
+    while (position < end && (*position == ' ' || *position == '\n' || *position == '\t' || *position == '\r'))
+        position++;
+    if (position == end) return 0;
 
-    // Instantiate the local available vector;
-    availableLocal = malloc(resourceCount * sizeof(int));
-    // Copy over the values
-    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    // Take the sign and digits
+    if (*position == '-')
     {
-        availableLocal[resourceIndex] = available[resourceIndex];
+        isNegative = 1;
+        position++;
     }
-    // Instantiate the completed tracking array
-    completed = malloc(processCount * sizeof(int));
-    for (processIndex = 0; processIndex < processCount; processIndex++)
+    if (position == end || *position < '0' || *position > '9') return 0;
+    while (position < end && *position >= '0' && *position <= '9')
     {
-        completed[processIndex] = 0;
+        result = result * 10 + (*position - '0');
+        if (result > 2147483647LL) return 0;
+        position++;
     }
 
-    // Iterate over each process and check if they can be executed
-    do
-    {
-        // Reset the all-completed flag
-        allCompleted = 1;
-        // Reset the any-completed flag
-        anyCompleted = 0;
+    *value = (int) (isNegative ? -result : result);
+    *cursor = position;
+    return 1;
+}
 
-        // Check if any process is not done yet
-        for (processIndex = 0; processIndex < processCount; processIndex++)
-        {
-            if (!completed[processIndex]) allCompleted = 0;
-        }
+void FreeLoadedState(struct LoadedState* loaded)
+{
+    // Free every buffer (all safe on NULL)
+    free(loaded->resources);
+    free(loaded->maxClaim);
+    free(loaded->allocated);
+    loaded->resources = NULL;
+    loaded->maxClaim = NULL;
+    loaded->allocated = NULL;
+}
 
-        // Try to sequence each process
-        for (processIndex = 0; processIndex < processCount; processIndex++)
-        {
-            // Reset the flag indicating we can sequence this process
-            canSequence = 1;
+int AllocateLoadedState(struct LoadedState* loaded, int processes, int resourceTypes)
+{
+    // Sizes the buffers for a state of processes x resourceTypes; returns 0 if they couldn't be allocated.
+    // Declare variables
+    size_t matrixSize = (size_t) processes * resourceTypes * sizeof(int);
 
-            // Continue if we've sequenced this already
-            if (completed[processIndex]) continue;
+    loaded->processCount = processes;
+    loaded->resourceCount = resourceTypes;
+    loaded->resources = malloc(resourceTypes * sizeof(int));
+    loaded->maxClaim = malloc(matrixSize);
+    loaded->allocated = malloc(matrixSize);
+    if (loaded->resources == NULL || loaded->maxClaim == NULL || loaded->allocated == NULL)
+    {
+        printf("ERROR: Not enough memory for a state of %d processes x %d resources!\n", processes, resourceTypes);
+        FreeLoadedState(loaded);
+        return 0;
+    }
 
-            // Check if we can sequence this process
-            for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
-            {
-                // Check if we don't have enough resources to
-                if (needed[processIndex][resourceIndex] > availableLocal[resourceIndex])
-                {
-                    // Indicate we can't sequence this process
-                    canSequence = 0;
-                    // Break
-                    break;
-                }
-            }
+    return 1;
+}
 
-            // Get the string for the needed and available resources
-            printStringA = malloc(sizeof(char) * 1024);
-            printStringA[0] = '\0';
-            printStringB = malloc(sizeof(char) * 1024);
-            printStringB[0] = '\0';
-            for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+int CheckLoadedState(const struct LoadedState* loaded)
+{
+    // Checks a parsed state's resources are positive and its rows aren't negative; returns whether it's usable.
+    // Declare variables
+    int resourceIndex;
+    size_t entryIndex;
+    size_t entryCount = (size_t) loaded->processCount * loaded->resourceCount;
+
+    // Error Checking
+    for (resourceIndex = 0; resourceIndex < loaded->resourceCount; resourceIndex++)
+    {
+        if (loaded->resources[resourceIndex] <= 0)
+        {
+            printf("ERROR: All resources must be at least 1!\n");
+            return 0;
+        }
+    }
+    for (entryIndex = 0; entryIndex < entryCount; entryIndex++)
+    {
+        if (loaded->maxClaim[entryIndex] < 0 || loaded->allocated[entryIndex] < 0)
+        {
+            printf("ERROR: Process p%d has a negative max or allocation!\n", (int) (entryIndex / loaded->resourceCount));
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void AdoptLoadedState(const struct LoadedState* loaded)
+{
+    // Replaces the global state with an accepted one, then derives available and needed a row at a time.
+    // Declare variables
+    int processIndex;
+    size_t rowBytes = loaded->resourceCount * sizeof(int);
+
+    // Size the state and copy each block in
+    processCount = loaded->processCount;
+    resourceCount = loaded->resourceCount;
+    AllocateState();
+    memcpy(resources, loaded->resources, rowBytes);
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        memcpy(MatrixRow(maxClaim, processIndex), loaded->maxClaim + (size_t) processIndex * resourceCount, rowBytes);
+        memcpy(MatrixRow(allocated, processIndex), loaded->allocated + (size_t) processIndex * resourceCount, rowBytes);
+    }
+
+    // Derive the available and needed resources
+    memcpy(available, resources, rowStride * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        memcpy(MatrixRow(needed, processIndex), MatrixRow(maxClaim, processIndex), rowStride * sizeof(int));
+        SubtractRow(MatrixRow(needed, processIndex), MatrixRow(allocated, processIndex), rowStride);
+        SubtractRow(available, MatrixRow(allocated, processIndex), rowStride);
+    }
+}
+
+int LoadTextState(const char* text, const char* end, struct LoadedState* loaded)
+{
+    // Reads "processes resources", then the units of each resource, then every process's max row,
+    // then every process's allocated row, all whitespace-separated.
+    // Declare variables
+    int processes;
+    int resourceTypes;
+    size_t entryIndex;
+    size_t entryCount;
+
+    // Take the counts
+    if (!ParseNextInt(&text, end, &processes) || !ParseNextInt(&text, end, &resourceTypes)
+        || processes <= 0 || resourceTypes <= 0)
+    {
+        printf("ERROR: State file must start with positive process and resource counts!\n");
+        return 0;
+    }
+    if (!AllocateLoadedState(loaded, processes, resourceTypes)) return 0;
+
+    // Take the resources, then both matrices
+    entryCount = (size_t) processes * resourceTypes;
+    for (entryIndex = 0; entryIndex < (size_t) resourceTypes; entryIndex++)
+    {
+        if (!ParseNextInt(&text, end, &loaded->resources[entryIndex])) break;
+    }
+    if (entryIndex == (size_t) resourceTypes)
+    {
+        for (entryIndex = 0; entryIndex < 2 * entryCount; entryIndex++)
+        {
+            if (!ParseNextInt(&text, end, entryIndex < entryCount ? &loaded->maxClaim[entryIndex]
+                                                                  : &loaded->allocated[entryIndex - entryCount])) break;
+        }
+        if (entryIndex == 2 * entryCount) return 1;
+    }
+
+    printf("ERROR: State file ended early or held something other than an integer!\n");
+    FreeLoadedState(loaded);
+    return 0;
+}
+
+int LoadBinaryState(const char* data, size_t size, struct LoadedState* loaded)
+{
+    // Copies a binary state (see StateFileHeader, which the caller has checked fits) into the buffers.
+    // Declare variables
+    struct StateFileHeader header;
+    size_t rowBytes;
+    size_t matrixBytes;
+
+    // Error Checking
+    memcpy(&header, data, sizeof(header));
+    if (header.version != STATE_FILE_VERSION || header.processCount <= 0 || header.resourceCount <= 0
+        || size != sizeof(header) + ((size_t) 2 * header.processCount + 1) * header.resourceCount * sizeof(int))
+    {
+        printf("ERROR: Binary state file is the wrong version or size!\n");
+        return 0;
+    }
+    if (!AllocateLoadedState(loaded, header.processCount, header.resourceCount)) return 0;
+
+    // Copy each block in
+    rowBytes = header.resourceCount * sizeof(int);
+    matrixBytes = (size_t) header.processCount * rowBytes;
+    data += sizeof(header);
+    memcpy(loaded->resources, data, rowBytes);
+    memcpy(loaded->maxClaim, data + rowBytes, matrixBytes);
+    memcpy(loaded->allocated, data + rowBytes + matrixBytes, matrixBytes);
+
+    return 1;
+}
+
+const char* MapFile(const char* path, size_t* size)
+{
+    // Maps a whole file read-only for one sequential pass; returns NULL (after printing why) on failure.
+    // Declare variables
+    int fileDescriptor;
+    struct stat fileStatus;
+    const char* data;
+
+    // Open it and find its size
+    fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+    {
+        printf("ERROR: Could not open state file %s!\n", path);
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        return NULL;
+    }
+
+    // Map it
+    data = mmap(NULL, (size_t) fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (data == MAP_FAILED)
+    {
+        printf("ERROR: Could not map state file %s!\n", path);
+        return NULL;
+    }
+    madvise((void*) data, (size_t) fileStatus.st_size, MADV_SEQUENTIAL);
+
+    *size = (size_t) fileStatus.st_size;
+    return data;
+}
+
+int LoadStateFile(const char* path)
+{
+    // Replaces the state with the contents of a text or binary state file; returns whether it loaded.
+    // The file is parsed and checked in full before anything is replaced, so a bad file leaves the state alone.
+    // Declare variables
+    int isLoaded;
+    size_t size;
+    const char* data;
+    struct LoadedState loaded = {0, 0, NULL, NULL, NULL};
+
+    // Map the whole file
+    data = MapFile(path, &size);
+    if (data == NULL) return 0;
+
+    // Branch on the format
+    if (size >= sizeof(struct StateFileHeader) && memcmp(data, STATE_FILE_MAGIC, 4) == 0)
+        isLoaded = LoadBinaryState(data, size, &loaded);
+    else
+        isLoaded = LoadTextState(data, data + size, &loaded);
+    munmap((void*) data, size);
+
+    // Swap it in only once it's been accepted
+    isLoaded = isLoaded && CheckLoadedState(&loaded);
+    if (isLoaded) AdoptLoadedState(&loaded);
+    FreeLoadedState(&loaded);
+
+    return isLoaded;
+}
+
+int SaveStateFile(const char* path)
+{
+    // Writes the state in the binary form LoadStateFile reads back, through a shared mapping of the file,
+    // and syncs it to disk; returns whether it was written.
+    // Declare variables
+    int processIndex;
+    int fileDescriptor;
+    int isWritten;
+    size_t rowBytes = resourceCount * sizeof(int);
+    size_t size = sizeof(struct StateFileHeader) + ((size_t) 2 * processCount + 1) * rowBytes;
+    struct StateFileHeader header;
+    char* data;
+    char* cursor;
+
+    // Error Checking
+    if (needed == NULL) return 0;
+    fileDescriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) return 0;
+    if (ftruncate(fileDescriptor, (off_t) size) != 0
+        || (data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0)) == MAP_FAILED)
+    {
+        close(fileDescriptor);
+        return 0;
+    }
+
+    // Copy in the header, then each block without its padding
+    memcpy(header.magic, STATE_FILE_MAGIC, 4);
+    header.version = STATE_FILE_VERSION;
+    header.processCount = processCount;
+    header.resourceCount = resourceCount;
+    memcpy(data, &header, sizeof(header));
+    cursor = data + sizeof(header);
+    memcpy(cursor, resources, rowBytes);
+    cursor += rowBytes;
+    for (processIndex = 0; processIndex < processCount; processIndex++, cursor += rowBytes)
+    {
+        memcpy(cursor, MatrixRow(maxClaim, processIndex), rowBytes);
+    }
+    for (processIndex = 0; processIndex < processCount; processIndex++, cursor += rowBytes)
+    {
+        memcpy(cursor, MatrixRow(allocated, processIndex), rowBytes);
+    }
+
+    // Push it all to disk
+    isWritten = msync(data, size, MS_SYNC) == 0;
+    munmap(data, size);
+    isWritten = fsync(fileDescriptor) == 0 && isWritten;
+
+    return close(fileDescriptor) == 0 && isWritten;
+}
+
+void TakeStateFile()
+{
+    // Declare variables
+    char path[1024];
+
+    printf("Enter path of state file: ");
+    scanf("%1023s", path);
+    // Clear the input
+    fflush(stdin);
+
+    // Load it and show the result
+    if (LoadStateFile(path))
+    {
+        printf("Loaded %d processes x %d resources.\n", processCount, resourceCount);
+        PrintResources();
+        if (processCount <= 64 && resourceCount <= 16) PrintProcesses();
+    }
+}
+
+double PhaseClock()
+{
+    // The time now if the solvers are timing their phases, otherwise 0 so the differences add nothing.
+    return solverTiming ? NowSeconds() : 0;
+}
+
+void CountCheck(struct SolverStats* stats, int shortfall)
+{
+    // Records one test that FindShortfall answered with shortfall (resourceCount or more if nothing was short).
+    stats->processChecks++;
+    stats->resourceComparisons += shortfall < resourceCount ? shortfall + 1 : resourceCount;
+    if (shortfall < resourceCount - 1) stats->earlyExits++;
+}
+
+void NoteScratchBytes(long long bytes)
+{
+    if (bytes > solverStats.peakScratchBytes) solverStats.peakScratchBytes = bytes;
+}
+
+int GreedySafeSequence(int* sequence)
+{
+    // Sweeps every unfinished process until a whole pass sequences nobody, tracing each check.
+    // Returns how many processes were written to the sequence.
+    // Declare variables
+    int processIndex;
+    int sequenced = 0;
+    int anyCompleted;
+    int canSequence;
+    int shortfall;
+    double passStart;
+    double releaseStart;
+    double passReleaseSeconds;
+
+    // Reset the local available vector and completed flags (padding included)
+    memcpy(sweepWork, available, rowStride * sizeof(int));
+    memset(sweepCompleted, 0, processCount);
+    NoteScratchBytes(rowStride * sizeof(int) + processCount);
+    solverStats.solves++;
+
+    // Iterate over each process and check if they can be executed
+    do
+    {
+        // Reset the any-completed flag
+        anyCompleted = 0;
+        solverStats.passes++;
+        passStart = PhaseClock();
+        passReleaseSeconds = 0;
+
+        // Try to sequence each process
+        for (processIndex = 0; processIndex < processCount; processIndex++)
+        {
+            // Continue if we've sequenced this already
+            if (sweepCompleted[processIndex]) continue;
+
+            // Check if we can sequence this process, i.e. no resource is short
+            shortfall = FindShortfall(MatrixRow(needed, processIndex), sweepWork, rowStride);
+            canSequence = shortfall == rowStride;
+            CountCheck(&solverStats, shortfall);
+
+            // Trace the needed and available resources
+            if (reportVerbosity >= REPORT_TRACE)
+            {
+                ReportText("\nChecking: <");
+                ReportRow(" ", MatrixRow(needed, processIndex), resourceCount);
+                ReportText(" > <= <");
+                ReportRow(" ", sweepWork, resourceCount);
+                ReportText(" > :p");
+                ReportInt(processIndex);
+                ReportText(canSequence ? " safely sequenced" : " could not be sequenced");
+            }
+
+            // Branch if we can sequence
+            if (canSequence)
+            {
+                // Flag that we've completed a process this cycle
+                anyCompleted = 1;
+                // Flag that this process is complete
+                sweepCompleted[processIndex] = 1;
+                sequence[sequenced++] = processIndex;
+                // Free the resources that were previously allocated
+                releaseStart = PhaseClock();
+                AddRow(sweepWork, MatrixRow(allocated, processIndex), rowStride);
+                passReleaseSeconds += PhaseClock() - releaseStart;
+                solverStats.releases++;
+            }
+        }
+        solverStats.checkSeconds += PhaseClock() - passStart - passReleaseSeconds;
+        solverStats.releaseSeconds += passReleaseSeconds;
+
+    } while (anyCompleted && sequenced < processCount);
+
+    ReportFlush();
+    return sequenced;
+}
+
+int CompareLongLong(const void* left, const void* right)
+{
+    // Declare variables
+    long long leftValue = *(const long long*) left;
+    long long rightValue = *(const long long*) right;
+
+    return (leftValue > rightValue) - (leftValue < rightValue);
+}
+
+int EventDrivenSafeSequence(const int* demand, const int* availableStart, int* sequence)
+{
+    // Sequences processes by reacting to each release instead of re-sweeping everybody.
+    // For every resource the processes it blocks are kept sorted by demand, with a cursor marking how many
+    // the growing available count already satisfies; a process is ready once its last blocking resource is passed.
+    // Returns how many processes were written to the sequence (which doubles as the ready queue).
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    int head = 0;
+    int tail = 0;
+    long long position;
+    long long limit;
+    long long blockedTotal = 0;
+    const int* row;
+    double phaseStart = PhaseClock();
+
+    int* work; // The available resources as processes complete.
+    int* zeros; // An all-zero row, for finding the resources a process holds.
+    int* blockedBy; // The number of resources each process is still waiting on.
+    long long* blockedStart; // Where each resource's slice of blockedKeys starts (resourceCount + 1 entries).
+    long long* blockedCursor; // How far into its slice each resource has satisfied.
+    long long* blockedKeys; // Per resource, demand * 2^32 + process for each process it blocks, ascending.
+
+    // Instantiate the working vectors
+    work = AllocateMatrix(1);
+    memcpy(work, availableStart, rowStride * sizeof(int));
+    zeros = AllocateMatrix(1);
+    blockedBy = calloc(processCount, sizeof(int));
+    blockedStart = calloc(resourceCount + 1, sizeof(long long));
+    blockedCursor = malloc((resourceCount + 1) * sizeof(long long));
+
+    // Count how many processes each resource blocks, and how many resources block each process
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = demand + (size_t) processIndex * rowStride;
+        resourceIndex = FindShortfall(row, work, resourceCount);
+        while (resourceIndex < resourceCount)
+        {
+            blockedBy[processIndex]++;
+            blockedStart[resourceIndex + 1]++;
+            // Jump straight to the next short resource
+            resourceIndex += 1 + FindShortfall(row + resourceIndex + 1, work + resourceIndex + 1, resourceCount - resourceIndex - 1);
+        }
+    }
+    // Turn the counts into slice offsets
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        blockedStart[resourceIndex + 1] += blockedStart[resourceIndex];
+        blockedCursor[resourceIndex] = blockedStart[resourceIndex];
+    }
+    blockedTotal = blockedStart[resourceCount];
+
+    // Fill each resource's slice, then sort it by demand
+    blockedKeys = malloc((blockedTotal > 0 ? blockedTotal : 1) * sizeof(long long));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = demand + (size_t) processIndex * rowStride;
+        resourceIndex = FindShortfall(row, work, resourceCount);
+        while (resourceIndex < resourceCount)
+        {
+            blockedKeys[blockedCursor[resourceIndex]++] = (long long) row[resourceIndex] * 4294967296LL + processIndex;
+            resourceIndex += 1 + FindShortfall(row + resourceIndex + 1, work + resourceIndex + 1, resourceCount - resourceIndex - 1);
+        }
+    }
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        blockedCursor[resourceIndex] = blockedStart[resourceIndex];
+        qsort(blockedKeys + blockedStart[resourceIndex],
+              (size_t) (blockedStart[resourceIndex + 1] - blockedStart[resourceIndex]),
+              sizeof(long long), CompareLongLong);
+    }
+
+    // Queue every process nothing blocks
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        if (blockedBy[processIndex] == 0) sequence[tail++] = processIndex;
+    }
+    solverStats.solves++;
+    solverStats.passes++;
+    solverStats.processChecks += processCount;
+    solverStats.resourceComparisons += (long long) processCount * resourceCount;
+    NoteScratchBytes(2 * rowStride * sizeof(int) + processCount * sizeof(int)
+                     + (2 * (resourceCount + 1) + blockedTotal) * sizeof(long long));
+    solverStats.checkSeconds += PhaseClock() - phaseStart;
+    phaseStart = PhaseClock();
+
+    // Complete ready processes one at a time, releasing whoever their resources unblock
+    while (head < tail)
+    {
+        processIndex = sequence[head++];
+        row = MatrixRow(allocated, processIndex);
+        solverStats.releases++;
+
+        // Free the resources that were previously allocated
+        AddRow(work, row, rowStride);
+
+        // Advance the cursor of every resource that just grew, jumping between the ones it held (row > 0)
+        for (resourceIndex = FindShortfall(row, zeros, resourceCount); resourceIndex < resourceCount;
+             resourceIndex += 1 + FindShortfall(row + resourceIndex + 1, zeros, resourceCount - resourceIndex - 1))
+        {
+
+            // Everything with demand <= work sorts below (work + 1) * 2^32
+            limit = ((long long) work[resourceIndex] + 1) * 4294967296LL;
+            position = blockedCursor[resourceIndex];
+            while (position < blockedStart[resourceIndex + 1] && blockedKeys[position] < limit)
+            {
+                solverStats.processChecks++;
+                solverStats.resourceComparisons++;
+                // Release the process if this was the last resource blocking it
+                if (--blockedBy[blockedKeys[position] & 0xFFFFFFFFLL] == 0)
+                {
+                    sequence[tail++] = (int) (blockedKeys[position] & 0xFFFFFFFFLL);
+                }
+                position++;
+            }
+            blockedCursor[resourceIndex] = position;
+        }
+    }
+
+    solverStats.releaseSeconds += PhaseClock() - phaseStart;
+
+    // Free the local tracking arrays
+    FreeAligned(work);
+    FreeAligned(zeros);
+    free(blockedBy);
+    free(blockedStart);
+    free(blockedCursor);
+    free(blockedKeys);
+
+    return tail;
+}
+
+void ScanPendingSlice(struct ParallelSolve* solve, int threadIndex)
+{
+    // Checks this thread's share of the pending processes against the sweep's available resources,
+    // adding the allocation of each one that fits into the thread's own release total.
+    // Declare variables
+    int slot;
+    int processIndex;
+    int shortfall;
+    int sliceStart = (int) ((long long) solve->pendingCount * threadIndex / solve->threadCount);
+    int sliceEnd = (int) ((long long) solve->pendingCount * (threadIndex + 1) / solve->threadCount);
+    int* partial = solve->partials + (size_t) threadIndex * rowStride;
+
+    // Reset the release total
+    memset(partial, 0, rowStride * sizeof(int));
+
+    // Check each process in the slice
+    for (slot = sliceStart; slot < sliceEnd; slot++)
+    {
+        processIndex = solve->pending[slot];
+        shortfall = FindShortfall(solve->demand + (size_t) processIndex * rowStride, solve->work, rowStride);
+        solve->finishedNow[slot] = shortfall == rowStride;
+        CountCheck(&solve->threadStats[threadIndex], shortfall);
+        if (solve->finishedNow[slot]) AddRow(partial, MatrixRow(allocated, processIndex), rowStride);
+    }
+}
+
+void* ParallelWorkerMain(void* argument)
+{
+    // Declare variables
+    struct ParallelWorker* worker = argument;
+    struct ParallelSolve* solve = worker->solve;
+
+    // Scan a slice of every sweep until the coordinator is done
+    while (1)
+    {
+        pthread_barrier_wait(&solve->sweepStart);
+        if (solve->isDone) break;
+        ScanPendingSlice(solve, worker->threadIndex);
+        pthread_barrier_wait(&solve->sweepEnd);
+    }
+
+    return NULL;
+}
+
+int ParallelSafeSequence(const int* demand, const int* availableStart, int* sequence)
+{
+    // Sweeps the unfinished processes like the greedy solver, but splits each sweep across threads.
+    // Every thread checks against the same available vector and keeps its own release total, and the
+    // totals are summed once the sweep ends, so the verdict matches the serial sweep exactly.
+    // Returns how many processes were written to the sequence.
+    // Declare variables
+    int slot;
+    int threadIndex;
+    int keptCount;
+    int sequenced = 0;
+    double phaseStart;
+    struct ParallelSolve solve;
+    struct ParallelWorker* workers;
+    pthread_t* threads;
+
+    // Decide how many threads to use
+    solve.threadCount = workerCount > 0 ? workerCount : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (solve.threadCount < 1) solve.threadCount = 1;
+    if (solve.threadCount > processCount) solve.threadCount = processCount > 0 ? processCount : 1;
+
+    // Instantiate the shared state
+    solve.demand = demand;
+    solve.work = AllocateMatrix(1);
+    memcpy(solve.work, availableStart, rowStride * sizeof(int));
+    solve.pending = malloc(processCount * sizeof(int));
+    solve.finishedNow = malloc(processCount > 0 ? processCount : 1);
+    solve.partials = AllocateMatrix(solve.threadCount);
+    solve.threadStats = calloc(solve.threadCount, sizeof(struct SolverStats));
+    NoteScratchBytes((1 + (long long) solve.threadCount) * rowStride * sizeof(int) + processCount * (sizeof(int) + 1));
+    solverStats.solves++;
+    solve.pendingCount = processCount;
+    solve.isDone = processCount == 0;
+    for (slot = 0; slot < processCount; slot++)
+    {
+        solve.pending[slot] = slot;
+    }
+    pthread_barrier_init(&solve.sweepStart, NULL, solve.threadCount);
+    pthread_barrier_init(&solve.sweepEnd, NULL, solve.threadCount);
+
+    // Start the workers (this thread scans slice 0)
+    workers = malloc(solve.threadCount * sizeof(struct ParallelWorker));
+    threads = malloc(solve.threadCount * sizeof(pthread_t));
+    for (threadIndex = 1; threadIndex < solve.threadCount; threadIndex++)
+    {
+        workers[threadIndex].solve = &solve;
+        workers[threadIndex].threadIndex = threadIndex;
+        pthread_create(&threads[threadIndex], NULL, ParallelWorkerMain, &workers[threadIndex]);
+    }
+
+    // Run sweeps until one sequences nobody
+    while (1)
+    {
+        pthread_barrier_wait(&solve.sweepStart);
+        if (solve.isDone) break;
+        solverStats.passes++;
+        phaseStart = PhaseClock();
+        ScanPendingSlice(&solve, 0);
+        pthread_barrier_wait(&solve.sweepEnd);
+        solverStats.checkSeconds += PhaseClock() - phaseStart;
+        phaseStart = PhaseClock();
+
+        // Merge every thread's releases
+        for (threadIndex = 0; threadIndex < solve.threadCount; threadIndex++)
+        {
+            AddRow(solve.work, solve.partials + (size_t) threadIndex * rowStride, rowStride);
+        }
+
+        // Move the finished processes into the sequence, keeping the rest in order
+        keptCount = 0;
+        for (slot = 0; slot < solve.pendingCount; slot++)
+        {
+            if (solve.finishedNow[slot]) sequence[sequenced++] = solve.pending[slot];
+            else solve.pending[keptCount++] = solve.pending[slot];
+        }
+        solverStats.releases += solve.pendingCount - keptCount;
+        solve.isDone = keptCount == solve.pendingCount || keptCount == 0;
+        solve.pendingCount = keptCount;
+        solverStats.releaseSeconds += PhaseClock() - phaseStart;
+    }
+
+    // Wait for the workers to exit
+    for (threadIndex = 1; threadIndex < solve.threadCount; threadIndex++)
+    {
+        pthread_join(threads[threadIndex], NULL);
+    }
+
+    // Merge every thread's counters
+    for (threadIndex = 0; threadIndex < solve.threadCount; threadIndex++)
+    {
+        solverStats.processChecks += solve.threadStats[threadIndex].processChecks;
+        solverStats.resourceComparisons += solve.threadStats[threadIndex].resourceComparisons;
+        solverStats.earlyExits += solve.threadStats[threadIndex].earlyExits;
+    }
+
+    // Free the shared state
+    pthread_barrier_destroy(&solve.sweepStart);
+    pthread_barrier_destroy(&solve.sweepEnd);
+    FreeAligned(solve.work);
+    FreeAligned(solve.partials);
+    free(solve.pending);
+    free(solve.finishedNow);
+    free(solve.threadStats);
+    free(workers);
+    free(threads);
+
+    return sequenced;
+}
+
+/***************************************************************/
+// Fixed-width kernels: for 4-16 resources a whole need row fits in one SIMD register (two without AVX2), so each
+// of these sweeps is generated for one lane count and lane type, with the row check and release down to an
+// instruction or two each. Rows are packed into 16-bit lanes when every value fits, which doubles how many
+// resources one register holds.
+#if defined(__SSE2__)
+__m128i LoadI128(const void* row) { return _mm_load_si128((const __m128i*) row); }
+int IsShortI16x8(__m128i need, __m128i work) { return _mm_movemask_epi8(_mm_cmpgt_epi16(need, work)); }
+int IsShortI32x4(__m128i need, __m128i work) { return _mm_movemask_epi8(_mm_cmpgt_epi32(need, work)); }
+__m128i AddI16x8(__m128i work, __m128i held) { return _mm_add_epi16(work, held); }
+__m128i AddI32x4(__m128i work, __m128i held) { return _mm_add_epi32(work, held); }
+#endif
+#if defined(__AVX2__)
+__m256i LoadI256(const void* row) { return _mm256_load_si256((const __m256i*) row); }
+int IsShortI16x16(__m256i need, __m256i work) { return _mm256_movemask_epi8(_mm256_cmpgt_epi16(need, work)); }
+int IsShortI32x8(__m256i need, __m256i work) { return _mm256_movemask_epi8(_mm256_cmpgt_epi32(need, work)); }
+__m256i AddI16x16(__m256i work, __m256i held) { return _mm256_add_epi16(work, held); }
+__m256i AddI32x8(__m256i work, __m256i held) { return _mm256_add_epi32(work, held); }
+#elif defined(__SSE2__)
+// Without AVX2 the 16 narrow and 8 wide lane kernels hold each row in a pair of SSE2 registers
+struct PairI128
+{
+    __m128i low; // The first half of the row.
+    __m128i high; // The second half of the row.
+};
+struct PairI128 LoadPairI128(const void* row)
+{
+    struct PairI128 pair = {LoadI128(row), LoadI128((const __m128i*) row + 1)};
+    return pair;
+}
+int IsShortPairI16x8(struct PairI128 need, struct PairI128 work)
+{
+    return IsShortI16x8(need.low, work.low) | IsShortI16x8(need.high, work.high);
+}
+int IsShortPairI32x4(struct PairI128 need, struct PairI128 work)
+{
+    return IsShortI32x4(need.low, work.low) | IsShortI32x4(need.high, work.high);
+}
+struct PairI128 AddPairI16x8(struct PairI128 work, struct PairI128 held)
+{
+    work.low = AddI16x8(work.low, held.low);
+    work.high = AddI16x8(work.high, held.high);
+    return work;
+}
+struct PairI128 AddPairI32x4(struct PairI128 work, struct PairI128 held)
+{
+    work.low = AddI32x4(work.low, held.low);
+    work.high = AddI32x4(work.high, held.high);
+    return work;
+}
+#endif
+
+// Defines a greedy sweep over packed rows of the given lane type and count, compacting the pending list each pass
+#define DEFINE_FIXED_WIDTH_SWEEP(functionName, laneType, lanes, vectorType, loadRow, isShort, addRow)        \
+int functionName(const laneType* need, const laneType* held, const laneType* availableStart,                 \
+                 int* pending, int* sequence)                                                                \
+{                                                                                                            \
+    int slot;                                                                                                \
+    int keptCount;                                                                                           \
+    int processIndex;                                                                                        \
+    int pendingCount = processCount;                                                                         \
+    int sequenced = 0;                                                                                       \
+    vectorType work = loadRow(availableStart);                                                               \
+                                                                                                             \
+    for (slot = 0; slot < processCount; slot++) pending[slot] = slot;                                        \
+    while (pendingCount > 0)                                                                                 \
+    {                                                                                                        \
+        keptCount = 0;                                                                                       \
+        for (slot = 0; slot < pendingCount; slot++)                                                          \
+        {                                                                                                    \
+            processIndex = pending[slot];                                                                    \
+            if (isShort(loadRow(need + (size_t) processIndex * (lanes)), work))                             \
+                pending[keptCount++] = processIndex;                                                         \
+            else                                                                                             \
+            {                                                                                                \
+                work = addRow(work, loadRow(held + (size_t) processIndex * (lanes)));                       \
+                sequence[sequenced++] = processIndex;                                                        \
+            }                                                                                                \
+        }                                                                                                    \
+        solverStats.passes++;                                                                                \
+        solverStats.processChecks += pendingCount;                                                           \
+        solverStats.resourceComparisons += (long long) pendingCount * resourceCount;                         \
+        if (keptCount == pendingCount) break;                                                                \
+        pendingCount = keptCount;                                                                            \
+    }                                                                                                        \
+    solverStats.releases += sequenced;                                                                       \
+                                                                                                             \
+    return sequenced;                                                                                        \
+}
+
+#if defined(__SSE2__)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI16x8, short, 8, __m128i, LoadI128, IsShortI16x8, AddI16x8)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI32x4, int, 4, __m128i, LoadI128, IsShortI32x4, AddI32x4)
+#endif
+#if defined(__AVX2__)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI16x16, short, 16, __m256i, LoadI256, IsShortI16x16, AddI16x16)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI32x8, int, 8, __m256i, LoadI256, IsShortI32x8, AddI32x8)
+#elif defined(__SSE2__)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI16x16, short, 16, struct PairI128, LoadPairI128, IsShortPairI16x8, AddPairI16x8)
+DEFINE_FIXED_WIDTH_SWEEP(SweepI32x8, int, 8, struct PairI128, LoadPairI128, IsShortPairI32x4, AddPairI32x4)
+#endif
+
+int FitsNarrowLanes()
+{
+    // Work never exceeds the resource totals, so 16-bit lanes are exact if the allocations and the available
+    // counts fit in them and every total stays below 32767, the value larger needs saturate to, which then
+    // still can't be met.
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    const int* row;
+
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        if (resources[resourceIndex] > 32766 || available[resourceIndex] < -32768) return 0;
+    }
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = MatrixRow(allocated, processIndex);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            if (row[resourceIndex] < 0 || row[resourceIndex] > 32767) return 0;
+        }
+    }
+
+    return 1;
+}
+
+#if defined(__SSE2__)
+void* PackRows(int* matrix, int rows, int lanes, int isNarrow)
+{
+    // Copies each row's first lanes values (padding included, so lanes <= rowStride) into 16 or 32-bit lanes,
+    // saturating 16-bit lanes at 32767. FitsNarrowLanes keeps every total below that, so a saturated need
+    // stays above every work value the sweep can reach.
+    // Declare variables
+    int processIndex;
+    int laneIndex;
+    const int* row;
+    short* narrow;
+    int* wide;
+    void* packed = AllocateAligned((size_t) rows * lanes * (isNarrow ? sizeof(short) : sizeof(int)));
+
+    narrow = packed;
+    wide = packed;
+    for (processIndex = 0; processIndex < rows; processIndex++)
+    {
+        row = MatrixRow(matrix, processIndex);
+        if (!isNarrow)
+        {
+            memcpy(wide + (size_t) processIndex * lanes, row, lanes * sizeof(int));
+            continue;
+        }
+        // Narrow eight values at a time
+        for (laneIndex = 0; laneIndex < lanes; laneIndex += 8)
+        {
+            _mm_store_si128((__m128i*) (narrow + (size_t) processIndex * lanes + laneIndex),
+                            _mm_packs_epi32(LoadI128(row + laneIndex), LoadI128(row + laneIndex + 4)));
+        }
+    }
+
+    return packed;
+}
+#endif
+
+int FixedWidthSafeSequence(int* sequence)
+{
+    // Picks the narrowest kernel the resource count and value ranges allow, packs the state for it and sweeps.
+    // Falls back to the greedy sweep when there are too many resources or no kernel was compiled in.
+    // Declare variables
+    int sequenced = -1;
+    int lanes = 0;
+    int isNarrow = FitsNarrowLanes();
+#if defined(__SSE2__)
+    int* pending;
+    void* packedNeed;
+    void* packedHeld;
+    void* packedAvailable;
+    double phaseStart;
+#endif
+
+    // Choose the lane count
+#if defined(__SSE2__)
+    if (isNarrow && resourceCount <= 8) lanes = 8;
+    else if (!isNarrow && resourceCount <= 4) lanes = 4;
+    else if (isNarrow && resourceCount <= 16) lanes = 16;
+    else if (!isNarrow && resourceCount <= 8) lanes = 8;
+#endif
+    if (lanes == 0) return GreedySafeSequence(sequence);
+
+#if defined(__SSE2__)
+    // Pack the rows and run the matching kernel
+    packedNeed = PackRows(needed, processCount, lanes, isNarrow);
+    packedHeld = PackRows(allocated, processCount, lanes, isNarrow);
+    packedAvailable = PackRows(available, 1, lanes, isNarrow);
+    pending = malloc(processCount * sizeof(int));
+    NoteScratchBytes((2 * (long long) processCount + 1) * lanes * (isNarrow ? sizeof(short) : sizeof(int))
+                     + processCount * sizeof(int));
+    solverStats.solves++;
+    // Releases are one register add inside the sweep, so the whole sweep counts as checking
+    phaseStart = PhaseClock();
+    if (isNarrow && lanes == 8) sequenced = SweepI16x8(packedNeed, packedHeld, packedAvailable, pending, sequence);
+    if (!isNarrow && lanes == 4) sequenced = SweepI32x4(packedNeed, packedHeld, packedAvailable, pending, sequence);
+    if (isNarrow && lanes == 16) sequenced = SweepI16x16(packedNeed, packedHeld, packedAvailable, pending, sequence);
+    if (!isNarrow && lanes == 8) sequenced = SweepI32x8(packedNeed, packedHeld, packedAvailable, pending, sequence);
+    solverStats.checkSeconds += PhaseClock() - phaseStart;
+
+    FreeAligned(packedNeed);
+    FreeAligned(packedHeld);
+    FreeAligned(packedAvailable);
+    free(pending);
+#endif
+
+    return sequenced;
+}
+
+/***************************************************************/
+void FreeSparseState(struct SparseState* state)
+{
+    // Free every array (all safe on NULL)
+    free(state->available);
+    free(state->allocated.rowStart);
+    free(state->allocated.columns);
+    free(state->allocated.values);
+    free(state->needed.rowStart);
+    free(state->needed.columns);
+    free(state->needed.values);
+    memset(state, 0, sizeof(*state));
+}
+
+void AllocateSparseMatrix(struct SparseMatrix* matrix, int rowCount, long long entryCount)
+{
+    // Size the arrays, leaving rowStart zeroed for counting into
+    matrix->rowCount = rowCount;
+    matrix->rowStart = calloc((size_t) rowCount + 1, sizeof(long long));
+    matrix->columns = malloc((size_t) (entryCount > 0 ? entryCount : 1) * sizeof(int));
+    matrix->values = malloc((size_t) (entryCount > 0 ? entryCount : 1) * sizeof(int));
+}
+
+void CompressMatrix(struct SparseMatrix* matrix, int* dense)
+{
+    // Builds a sparse copy of a flat dense matrix in two passes: count, then fill.
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    long long entryCount = 0;
+    long long entry;
+    const int* row;
+
+    // Count the non-zero entries
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = MatrixRow(dense, processIndex);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            if (row[resourceIndex] != 0) entryCount++;
+        }
+    }
+
+    // Fill them in, row by row
+    AllocateSparseMatrix(matrix, processCount, entryCount);
+    entry = 0;
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        matrix->rowStart[processIndex] = entry;
+        row = MatrixRow(dense, processIndex);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            if (row[resourceIndex] == 0) continue;
+            matrix->columns[entry] = resourceIndex;
+            matrix->values[entry++] = row[resourceIndex];
+        }
+    }
+    matrix->rowStart[processCount] = entry;
+}
+
+void CompressState(struct SparseState* state)
+{
+    // Builds a sparse copy of the dense state
+    state->processCount = processCount;
+    state->resourceCount = resourceCount;
+    state->available = malloc(resourceCount * sizeof(int));
+    memcpy(state->available, available, resourceCount * sizeof(int));
+    CompressMatrix(&state->allocated, allocated);
+    CompressMatrix(&state->needed, needed);
+}
+
+int SparseSafeSequence(const struct SparseState* state, int* sequence)
+{
+    // The event-driven solver over non-zero entries only: a process is only blocked by the resources it
+    // actually needs more of, and only the resources it actually holds are advanced when it finishes,
+    // so the cost scales with the non-zero entries rather than processes x resources.
+    // Returns how many processes were written to the sequence (which doubles as the ready queue).
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    int head = 0;
+    int tail = 0;
+    long long entry;
+    long long position;
+    long long limit;
+    long long blockedTotal;
+    const struct SparseMatrix* need = &state->needed;
+    const struct SparseMatrix* held = &state->allocated;
+    double phaseStart = PhaseClock();
+
+    int* work; // The available resources as processes complete.
+    int* blockedBy; // The number of resources each process is still waiting on.
+    long long* blockedStart; // Where each resource's slice of blockedKeys starts (resourceCount + 1 entries).
+    long long* blockedCursor; // How far into its slice each resource has satisfied.
+    long long* blockedKeys; // Per resource, demand * 2^32 + process for each process it blocks, ascending.
+
+    // Instantiate the working vectors
+    work = malloc(state->resourceCount * sizeof(int));
+    memcpy(work, state->available, state->resourceCount * sizeof(int));
+    blockedBy = calloc(state->processCount, sizeof(int));
+    blockedStart = calloc(state->resourceCount + 1, sizeof(long long));
+    blockedCursor = malloc((state->resourceCount + 1) * sizeof(long long));
+
+    // Count the blocking entries per process and per resource
+    for (processIndex = 0; processIndex < state->processCount; processIndex++)
+    {
+        for (entry = need->rowStart[processIndex]; entry < need->rowStart[processIndex + 1]; entry++)
+        {
+            if (need->values[entry] > work[need->columns[entry]])
+            {
+                blockedBy[processIndex]++;
+                blockedStart[need->columns[entry] + 1]++;
+            }
+        }
+    }
+    for (resourceIndex = 0; resourceIndex < state->resourceCount; resourceIndex++)
+    {
+        blockedStart[resourceIndex + 1] += blockedStart[resourceIndex];
+        blockedCursor[resourceIndex] = blockedStart[resourceIndex];
+    }
+    blockedTotal = blockedStart[state->resourceCount];
+
+    // Fill each resource's slice, then sort it by demand
+    blockedKeys = malloc((size_t) (blockedTotal > 0 ? blockedTotal : 1) * sizeof(long long));
+    for (processIndex = 0; processIndex < state->processCount; processIndex++)
+    {
+        for (entry = need->rowStart[processIndex]; entry < need->rowStart[processIndex + 1]; entry++)
+        {
+            if (need->values[entry] > work[need->columns[entry]])
+            {
+                blockedKeys[blockedCursor[need->columns[entry]]++] = (long long) need->values[entry] * 4294967296LL + processIndex;
+            }
+        }
+    }
+    for (resourceIndex = 0; resourceIndex < state->resourceCount; resourceIndex++)
+    {
+        blockedCursor[resourceIndex] = blockedStart[resourceIndex];
+        qsort(blockedKeys + blockedStart[resourceIndex],
+              (size_t) (blockedStart[resourceIndex + 1] - blockedStart[resourceIndex]),
+              sizeof(long long), CompareLongLong);
+    }
+
+    // Queue every process nothing blocks
+    for (processIndex = 0; processIndex < state->processCount; processIndex++)
+    {
+        if (blockedBy[processIndex] == 0) sequence[tail++] = processIndex;
+    }
+    solverStats.solves++;
+    solverStats.passes++;
+    solverStats.processChecks += state->processCount;
+    solverStats.resourceComparisons += need->rowStart[state->processCount];
+    NoteScratchBytes((state->resourceCount + state->processCount) * sizeof(int)
+                     + (2 * (state->resourceCount + 1) + blockedTotal) * sizeof(long long));
+    solverStats.checkSeconds += PhaseClock() - phaseStart;
+    phaseStart = PhaseClock();
+
+    // Complete ready processes one at a time, advancing only the resources they hold
+    while (head < tail)
+    {
+        processIndex = sequence[head++];
+        solverStats.releases++;
+        for (entry = held->rowStart[processIndex]; entry < held->rowStart[processIndex + 1]; entry++)
+        {
+            if (held->values[entry] <= 0) continue;
+            resourceIndex = held->columns[entry];
+            work[resourceIndex] += held->values[entry];
+
+            // Everything with demand <= work sorts below (work + 1) * 2^32
+            limit = ((long long) work[resourceIndex] + 1) * 4294967296LL;
+            position = blockedCursor[resourceIndex];
+            while (position < blockedStart[resourceIndex + 1] && blockedKeys[position] < limit)
+            {
+                solverStats.processChecks++;
+                solverStats.resourceComparisons++;
+                // Release the process if this was the last resource blocking it
+                if (--blockedBy[blockedKeys[position] & 0xFFFFFFFFLL] == 0)
+                {
+                    sequence[tail++] = (int) (blockedKeys[position] & 0xFFFFFFFFLL);
+                }
+                position++;
+            }
+            blockedCursor[resourceIndex] = position;
+        }
+    }
+
+    solverStats.releaseSeconds += PhaseClock() - phaseStart;
+
+    // Free the local tracking arrays
+    free(work);
+    free(blockedBy);
+    free(blockedStart);
+    free(blockedCursor);
+    free(blockedKeys);
+
+    return tail;
+}
+
+int LoadSparseStateFile(const char* path, struct SparseState* state)
+{
+    // Reads "processes resources entries", the units of each resource, then one "process resource max allocated"
+    // line per non-zero claim, straight into sparse form; returns whether it loaded.
+    // Declare variables
+    int entryIndex;
+    int entryCount = 0;
+    int resourceIndex;
+    int values[4];
+    int valueIndex;
+    int isLoaded = 1;
+    long long* heldCursor;
+    long long* needCursor;
+    int* triples = NULL;
+    int* entryStart; // Where each process's entries start in entryOrder (processCount + 1 entries).
+    int* entryOrder; // The entries grouped by process.
+    int* lastProcess; // The last process each resource was seen listed for, or -1.
+    size_t size;
+    const char* data;
+    const char* cursor;
+    const char* end;
+
+    // Map the whole file and take the counts
+    data = MapFile(path, &size);
+    if (data == NULL) return 0;
+    cursor = data;
+    end = data + size;
+    memset(state, 0, sizeof(*state));
+    if (!ParseNextInt(&cursor, end, &state->processCount) || !ParseNextInt(&cursor, end, &state->resourceCount)
+        || !ParseNextInt(&cursor, end, &entryCount) || state->processCount <= 0 || state->resourceCount <= 0 || entryCount < 0)
+    {
+        printf("ERROR: Sparse state file must start with positive process, resource and entry counts!\n");
+        munmap((void*) data, size);
+        return 0;
+    }
+
+    // Take the resources, which start out fully available
+    state->available = malloc(state->resourceCount * sizeof(int));
+    for (resourceIndex = 0; resourceIndex < state->resourceCount && isLoaded; resourceIndex++)
+    {
+        isLoaded = ParseNextInt(&cursor, end, &state->available[resourceIndex]) && state->available[resourceIndex] > 0;
+    }
+
+    // Take every entry, counting how many each process holds and needs
+    triples = malloc((size_t) (entryCount > 0 ? entryCount : 1) * 4 * sizeof(int));
+    AllocateSparseMatrix(&state->allocated, state->processCount, entryCount);
+    AllocateSparseMatrix(&state->needed, state->processCount, entryCount);
+    for (entryIndex = 0; entryIndex < entryCount && isLoaded; entryIndex++)
+    {
+        for (valueIndex = 0; valueIndex < 4 && isLoaded; valueIndex++)
+        {
+            isLoaded = ParseNextInt(&cursor, end, &values[valueIndex]);
+        }
+        isLoaded = isLoaded && values[0] >= 0 && values[0] < state->processCount && values[1] >= 0
+                   && values[1] < state->resourceCount && values[2] >= 0 && values[3] >= 0;
+        if (!isLoaded) break;
+        memcpy(triples + (size_t) entryIndex * 4, values, sizeof(values));
+        if (values[3] != 0) state->allocated.rowStart[values[0] + 1]++;
+        if (values[2] - values[3] != 0) state->needed.rowStart[values[0] + 1]++;
+        state->available[values[1]] -= values[3];
+    }
+    munmap((void*) data, size);
+    if (!isLoaded)
+    {
+        printf("ERROR: Sparse state file ended early or held an out-of-range entry!\n");
+        free(triples);
+        FreeSparseState(state);
+        return 0;
+    }
+
+    // Group the entries by process, and reject a process listing the same resource twice
+    entryStart = calloc((size_t) state->processCount + 1, sizeof(int));
+    entryOrder = malloc((size_t) (entryCount > 0 ? entryCount : 1) * sizeof(int));
+    lastProcess = malloc((size_t) state->resourceCount * sizeof(int));
+    for (entryIndex = 0; entryIndex < entryCount; entryIndex++)
+    {
+        entryStart[triples[(size_t) entryIndex * 4] + 1]++;
+    }
+    for (entryIndex = 0; entryIndex < state->processCount; entryIndex++)
+    {
+        entryStart[entryIndex + 1] += entryStart[entryIndex];
+    }
+    for (entryIndex = 0; entryIndex < entryCount; entryIndex++)
+    {
+        entryOrder[entryStart[triples[(size_t) entryIndex * 4]]++] = entryIndex;
+    }
+    for (resourceIndex = 0; resourceIndex < state->resourceCount; resourceIndex++)
+    {
+        lastProcess[resourceIndex] = -1;
+    }
+    for (entryIndex = 0; entryIndex < entryCount && isLoaded; entryIndex++)
+    {
+        memcpy(values, triples + (size_t) entryOrder[entryIndex] * 4, sizeof(values));
+        isLoaded = lastProcess[values[1]] != values[0];
+        lastProcess[values[1]] = values[0];
+    }
+    free(entryStart);
+    free(entryOrder);
+    free(lastProcess);
+    if (!isLoaded)
+    {
+        printf("ERROR: Sparse state file listed p%d's claim on r%d more than once!\n", values[0], values[1]);
+        free(triples);
+        FreeSparseState(state);
+        return 0;
+    }
+
+    // Turn the counts into row offsets, then drop each entry into its row
+    heldCursor = malloc((size_t) state->processCount * sizeof(long long));
+    needCursor = malloc((size_t) state->processCount * sizeof(long long));
+    for (entryIndex = 0; entryIndex < state->processCount; entryIndex++)
+    {
+        state->allocated.rowStart[entryIndex + 1] += state->allocated.rowStart[entryIndex];
+        state->needed.rowStart[entryIndex + 1] += state->needed.rowStart[entryIndex];
+        heldCursor[entryIndex] = state->allocated.rowStart[entryIndex];
+        needCursor[entryIndex] = state->needed.rowStart[entryIndex];
+    }
+    for (entryIndex = 0; entryIndex < entryCount; entryIndex++)
+    {
+        memcpy(values, triples + (size_t) entryIndex * 4, sizeof(values));
+        if (values[3] != 0)
+        {
+            state->allocated.columns[heldCursor[values[0]]] = values[1];
+            state->allocated.values[heldCursor[values[0]]++] = values[3];
+        }
+        if (values[2] - values[3] != 0)
+        {
+            state->needed.columns[needCursor[values[0]]] = values[1];
+            state->needed.values[needCursor[values[0]]++] = values[2] - values[3];
+        }
+    }
+
+    free(heldCursor);
+    free(needCursor);
+    free(triples);
+    return 1;
+}
+
+void SolveSparseStateFile(const char* path)
+{
+    // Loads a sparse state file and checks it without ever building the dense matrices.
+    // Declare variables
+    struct SparseState state;
+    int* sequence;
+    int sequenced;
+    double start;
+    double loaded;
+
+    start = NowSeconds();
+    if (!LoadSparseStateFile(path, &state)) return;
+    loaded = NowSeconds();
+
+    // Solve it
+    sequence = malloc(state.processCount * sizeof(int));
+    sequenced = SparseSafeSequence(&state, sequence);
+    printf("%d processes x %d resources, %lld held and %lld needed entries\n"
+           "Loaded in %.3f ms, solved in %.3f ms: %s\n",
+           state.processCount, state.resourceCount,
+           state.allocated.rowStart[state.processCount], state.needed.rowStart[state.processCount],
+           (loaded - start) * 1000, (NowSeconds() - loaded) * 1000,
+           sequenced == state.processCount ? "safe" : "deadlock reached");
+
+    free(sequence);
+    FreeSparseState(&state);
+}
+
+void AdoptSafeSequence(const int* sequence)
+{
+    // Declare variables
+    int position;
+
+    // Store the sequence and where each process sits in it
+    for (position = 0; position < processCount; position++)
+    {
+        safeSequence[position] = sequence[position];
+        sequencePosition[sequence[position]] = position;
+    }
+    safeSequenceValid = 1;
+}
+
+int SolveSafeSequence(int mode, int* sequence)
+{
+    // Runs one of the SOLVER_* modes on the current state; returns how many processes were sequenced.
+    // Declare variables
+    int sequenced;
+    struct SparseState sparseCopy;
+
+    if (mode == SOLVER_EVENT_DRIVEN) sequenced = EventDrivenSafeSequence(needed, available, sequence);
+    else if (mode == SOLVER_PARALLEL) sequenced = ParallelSafeSequence(needed, available, sequence);
+    else if (mode == SOLVER_FIXED_WIDTH) sequenced = FixedWidthSafeSequence(sequence);
+    else if (mode == SOLVER_SPARSE)
+    {
+        CompressState(&sparseCopy);
+        sequenced = SparseSafeSequence(&sparseCopy, sequence);
+        FreeSparseState(&sparseCopy);
+    }
+    else sequenced = GreedySafeSequence(sequence);
+
+    return sequenced;
+}
+
+void FindSafeSequence()
+{
+    // Declare variables
+    int processIndex;
+    int sequenced;
+    int* sequence;
+
+    // Make sure there's a state to check
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    // Run the chosen solver
+    sequence = malloc(processCount * sizeof(int));
+    sequenced = SolveSafeSequence(solverMode, sequence);
+
+    // Remember the sequence for later requests
+    if (sequenced == processCount) AdoptSafeSequence(sequence);
+
+    if (reportVerbosity >= REPORT_SUMMARY)
+    {
+        if (sequenced < processCount)
+        {
+            // Print could not find safe sequence?
+            ReportText("\nDeadlock reached!");
+        }
+        else
+        {
+            // Print the safe sequence
+            ReportText("\nSafe sequence: <");
+            for (processIndex = 0; processIndex < processCount; processIndex++)
+            {
+                ReportText(" p");
+                ReportInt(sequence[processIndex]);
+            }
+            ReportText(" >");
+        }
+        ReportFlush();
+    }
+
+    free(sequence);
+}
+
+void ReportSolverStats(const char* label)
+{
+    // Streams the running solver totals as one JSON object, so runs and solvers can be compared by a script.
+    // Declare variables
+    char text[1024];
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    snprintf(text, sizeof(text),
+             "{\"solver\": \"%s\", \"processes\": %d, \"resources\": %d, \"solves\": %lld, \"passes\": %lld, "
+             "\"processChecks\": %lld, \"resourceComparisons\": %lld, \"earlyExits\": %lld, \"earlyExitRate\": %.4f, "
+             "\"releases\": %lld, \"checkMs\": %.3f, \"releaseMs\": %.3f, \"peakScratchBytes\": %lld, "
+             "\"maxResidentKB\": %ld}",
+             label, processCount, resourceCount, solverStats.solves, solverStats.passes, solverStats.processChecks,
+             solverStats.resourceComparisons, solverStats.earlyExits,
+             solverStats.processChecks > 0 ? (double) solverStats.earlyExits / solverStats.processChecks : 0.0,
+             solverStats.releases, solverStats.checkSeconds * 1000, solverStats.releaseSeconds * 1000,
+             solverStats.peakScratchBytes, usage.ru_maxrss);
+    ReportText(text);
+}
+
+void PrintSolverStats()
+{
+    // Dumps the totals since the last dump, then starts counting afresh
+    ReportText("\n");
+    ReportSolverStats(solverNames[solverMode]);
+    ReportFlush();
+    memset(&solverStats, 0, sizeof(solverStats));
+}
+
+void DumpStateFileStats(const char* path, int runs)
+{
+    // Runs every solver on a state file and dumps each one's totals as a JSON array.
+    // Declare variables
+    int mode;
+    int run;
+    int* sequence;
+
+    if (!LoadStateFile(path)) return;
+    reportVerbosity = REPORT_SILENT;
+    if (runs < 1) runs = 1;
+    sequence = malloc(processCount * sizeof(int));
+
+    ReportText("[");
+    for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++)
+    {
+        memset(&solverStats, 0, sizeof(solverStats));
+        for (run = 0; run < runs; run++)
+        {
+            SolveSafeSequence(mode, sequence);
+        }
+        ReportText(mode == SOLVER_GREEDY ? "\n  " : ",\n  ");
+        ReportSolverStats(solverNames[mode]);
+    }
+    ReportText("\n]\n");
+    ReportFlush();
+
+    free(sequence);
+    FreeState();
+}
+
+/***************************************************************/
+int SequencePrefixHolds(int length)
+{
+    // Checks that the first length processes of safeSequence can still run in order from the current available.
+    // Declare variables
+    int position;
+    int processIndex;
+
+    // Walk the prefix, releasing each process as it completes
+    memcpy(requestWork, available, rowStride * sizeof(int));
+    for (position = 0; position < length; position++)
+    {
+        processIndex = safeSequence[position];
+        if (FindShortfall(MatrixRow(needed, processIndex), requestWork, rowStride) < rowStride) return 0;
+        AddRow(requestWork, MatrixRow(allocated, processIndex), rowStride);
+    }
+
+    return 1;
+}
+
+void GrantResources(int processIndex, const int* request)
+{
+    // Moves request (resourceCount values) from available to the process without any checks.
+    SubtractRow(available, request, resourceCount);
+    AddRow(MatrixRow(allocated, processIndex), request, resourceCount);
+    SubtractRow(MatrixRow(needed, processIndex), request, resourceCount);
+}
+
+void ReturnResources(int processIndex, const int* release)
+{
+    // Moves release (resourceCount values) from the process back to available without any checks.
+    AddRow(available, release, resourceCount);
+    SubtractRow(MatrixRow(allocated, processIndex), release, resourceCount);
+    AddRow(MatrixRow(needed, processIndex), release, resourceCount);
+}
+
+int CheckRequest(int processIndex, const int* request)
+{
+    // Checks everything about a request except safety; returns REQUEST_GRANTED if it may be tried.
+    if (needed == NULL || processIndex < 0 || processIndex >= processCount || !IsVectorInRange(request))
+        return REQUEST_INVALID;
+    if (FindShortfall(request, MatrixRow(needed, processIndex), resourceCount) < resourceCount)
+        return REQUEST_EXCEEDS_CLAIM;
+    if (FindShortfall(request, available, resourceCount) < resourceCount)
+        return REQUEST_MUST_WAIT;
+
+    return REQUEST_GRANTED;
+}
+
+int IsGrantedStateSafe(int prefixLength)
+{
+    // Checks the state after some tentative grants, re-walking only the first prefixLength processes of the
+    // last safe sequence if it's known, and adopting a fresh sequence if a full solve was needed.
+    // Declare variables
+    int* swap;
+
+    // Try the cheap prefix check first, then fall back to a full solve
+    if (safeSequenceValid && SequencePrefixHolds(prefixLength)) return 1;
+    if (EventDrivenSafeSequence(needed, available, candidateSequence) < processCount) return 0;
+
+    // Swap the new sequence in and re-index it
+    swap = safeSequence;
+    safeSequence = candidateSequence;
+    candidateSequence = swap;
+    AdoptSafeSequence(safeSequence);
+    return 1;
+}
+
+int RequestResources(int processIndex, const int* request)
+{
+    // Grants the request (resourceCount values) only if the resulting state is safe; returns a REQUEST_* code.
+    // If the last safe sequence is known, only the processes ahead of the requester need re-checking:
+    // the request just leaves less available for them, and everything from the requester on sees the same state.
+    // Declare variables
+    int result = CheckRequest(processIndex, request);
+
+    if (result != REQUEST_GRANTED) return result;
+
+    // Tentatively grant the request, and roll it back if it was unsafe
+    GrantResources(processIndex, request);
+    if (!IsGrantedStateSafe(safeSequenceValid ? sequencePosition[processIndex] : 0))
+    {
+        ReturnResources(processIndex, request);
+        return REQUEST_UNSAFE;
+    }
+
+    detectionValid = 0;
+    return REQUEST_GRANTED;
+}
+
+int ReleaseResources(int processIndex, const int* release)
+{
+    // Returns resources (resourceCount values) a process holds; returns a REQUEST_* code.
+    // A release never invalidates the last safe sequence, so nothing is re-checked.
+    // Error Checking
+    if (needed == NULL || processIndex < 0 || processIndex >= processCount || !IsVectorInRange(release)
+        || FindShortfall(release, MatrixRow(allocated, processIndex), resourceCount) < resourceCount)
+        return REQUEST_INVALID;
+
+    // Hand the resources back
+    ReturnResources(processIndex, release);
+
+    detectionValid = 0;
+    return REQUEST_GRANTED;
+}
+
+/***************************************************************/
+// In-place changes: processes and resource types come and go without re-entering the state. Rows are
+// spare-capacity arrays that double when full, and the padding column of each row is where a new resource
+// type lands, so only a full row forces the matrices to be laid out again.
+int* ReshapeMatrix(int* matrix, int rows, int keptRows, int oldStride)
+{
+    // Moves the first keptRows rows (oldStride ints apart) into a fresh zeroed block of rows rows at the
+    // current rowStride, freeing the old block.
+    // Declare variables
+    int processIndex;
+    int* reshaped = AllocateMatrix(rows);
+
+    for (processIndex = 0; processIndex < keptRows; processIndex++)
+    {
+        memcpy(MatrixRow(reshaped, processIndex), matrix + (size_t) processIndex * oldStride, oldStride * sizeof(int));
+    }
+    FreeAligned(matrix);
+
+    return reshaped;
+}
+
+void ReshapeState(int capacity, int stride)
+{
+    // Gives every matrix room for capacity processes and every row stride ints, keeping what they hold.
+    // Declare variables
+    int oldStride = rowStride;
+
+    rowStride = stride;
+
+    // The vectors
+    resources = ReshapeMatrix(resources, 1, 1, oldStride);
+    available = ReshapeMatrix(available, 1, 1, oldStride);
+    requestWork = ReshapeMatrix(requestWork, 1, 1, oldStride);
+    sweepWork = ReshapeMatrix(sweepWork, 1, 1, oldStride);
+    detectionWork = ReshapeMatrix(detectionWork, 1, 1, oldStride);
+    detectionWaiters = ReshapeMatrix(detectionWaiters, 1, 1, oldStride);
+
+    // The matrices
+    maxClaim = ReshapeMatrix(maxClaim, capacity, processCount, oldStride);
+    allocated = ReshapeMatrix(allocated, capacity, processCount, oldStride);
+    needed = ReshapeMatrix(needed, capacity, processCount, oldStride);
+    requested = ReshapeMatrix(requested, capacity, processCount, oldStride);
+
+    // The per-process arrays
+    sweepCompleted = realloc(sweepCompleted, capacity);
+    detectionSequence = realloc(detectionSequence, capacity * sizeof(int));
+    detectionPosition = realloc(detectionPosition, capacity * sizeof(int));
+    detectionNextWaiter = realloc(detectionNextWaiter, capacity * sizeof(int));
+    detectionWaitingOn = realloc(detectionWaitingOn, capacity * sizeof(int));
+    safeSequence = realloc(safeSequence, capacity * sizeof(int));
+    sequencePosition = realloc(sequencePosition, capacity * sizeof(int));
+    candidateSequence = realloc(candidateSequence, capacity * sizeof(int));
+    processCapacity = capacity;
+}
+
+void SetProcessMax(int processIndex, const int* maxRow)
+{
+    // Replaces a process's max claim (resourceCount values) and its need without any checks.
+    memcpy(MatrixRow(maxClaim, processIndex), maxRow, resourceCount * sizeof(int));
+    memcpy(MatrixRow(needed, processIndex), maxRow, resourceCount * sizeof(int));
+    SubtractRow(MatrixRow(needed, processIndex), MatrixRow(allocated, processIndex), resourceCount);
+}
+
+void SetProcessAllocation(int processIndex, const int* allocatedRow)
+{
+    // Replaces a process's allocation (resourceCount values) without any checks, settling the difference
+    // with available and the process's need.
+    AddRow(available, MatrixRow(allocated, processIndex), resourceCount);
+    SubtractRow(available, allocatedRow, resourceCount);
+    AddRow(MatrixRow(needed, processIndex), MatrixRow(allocated, processIndex), resourceCount);
+    SubtractRow(MatrixRow(needed, processIndex), allocatedRow, resourceCount);
+    memcpy(MatrixRow(allocated, processIndex), allocatedRow, resourceCount * sizeof(int));
+}
+
+void AppendProcess(const int* maxRow)
+{
+    // Adds a process holding nothing as p(processCount) without any checks, doubling the rows if they're full.
+    if (processCount == processCapacity) ReshapeState(processCapacity * 2, rowStride);
+    processCount++;
+    SetProcessMax(processCount - 1, maxRow);
+}
+
+void SwapRemoveProcess(int processIndex)
+{
+    // Removes a process without any checks, handing back what it holds and moving the last process into its
+    // place, then zeroing the vacated rows so spare rows stay empty.
+    // Declare variables
+    int lastIndex = processCount - 1;
+
+    AddRow(available, MatrixRow(allocated, processIndex), resourceCount);
+    if (processIndex != lastIndex)
+    {
+        memcpy(MatrixRow(maxClaim, processIndex), MatrixRow(maxClaim, lastIndex), rowStride * sizeof(int));
+        memcpy(MatrixRow(allocated, processIndex), MatrixRow(allocated, lastIndex), rowStride * sizeof(int));
+        memcpy(MatrixRow(needed, processIndex), MatrixRow(needed, lastIndex), rowStride * sizeof(int));
+        memcpy(MatrixRow(requested, processIndex), MatrixRow(requested, lastIndex), rowStride * sizeof(int));
+    }
+    memset(MatrixRow(maxClaim, lastIndex), 0, rowStride * sizeof(int));
+    memset(MatrixRow(allocated, lastIndex), 0, rowStride * sizeof(int));
+    memset(MatrixRow(needed, lastIndex), 0, rowStride * sizeof(int));
+    memset(MatrixRow(requested, lastIndex), 0, rowStride * sizeof(int));
+    processCount--;
+}
+
+void AppendResourceType(int units)
+{
+    // Adds resource r(resourceCount) with units free and nobody claiming it, without any checks. The new
+    // column is padding every row already holds as zero; only once a row is full is everything laid out
+    // again, half as wide again, so adding types one at a time costs amortised O(processes) each.
+    if (resourceCount == rowStride) ReshapeState(processCapacity, rowStride + (rowStride / 2 + ROW_BLOCK - 1) / ROW_BLOCK * ROW_BLOCK);
+    resources[resourceCount] = units;
+    available[resourceCount] = units;
+    detectionWork[resourceCount] = units;
+    resourceCount++;
+}
+
+int AddProcess(const int* maxRow, const int* allocatedRow)
+{
+    // Adds a process with the given max claim and allocation (resourceCount values each) as p(processCount);
+    // returns a REQUEST_* code. If the last safe sequence is known and the newcomer holds nothing, it stays
+    // safe with the newcomer run last, provided its claim fits the resource totals.
+    // Declare variables
+    int wasSafe;
+
+    // Error Checking
+    if (needed == NULL || !IsVectorInRange(maxRow) || !IsVectorInRange(allocatedRow)) return REQUEST_INVALID;
+    if (FindShortfall(allocatedRow, maxRow, resourceCount) < resourceCount) return REQUEST_EXCEEDS_CLAIM;
+    if (FindShortfall(allocatedRow, available, resourceCount) < resourceCount) return REQUEST_MUST_WAIT;
+
+    wasSafe = safeSequenceValid && IsRowEmpty(allocatedRow)
+              && FindShortfall(maxRow, resources, resourceCount) == resourceCount;
+    AppendProcess(maxRow);
+    SetProcessAllocation(processCount - 1, allocatedRow);
+
+    // Keep the caches in step
+    if (wasSafe)
+    {
+        safeSequence[processCount - 1] = processCount - 1;
+        sequencePosition[processCount - 1] = processCount - 1;
+    }
+    else safeSequenceValid = 0;
+    detectionValid = 0;
+    return REQUEST_GRANTED;
+}
+
+int RemoveProcess(int processIndex)
+{
+    // Removes a process, handing back what it holds; the last process takes its index. Returns a REQUEST_* code.
+    // Removing a process only leaves more for the rest, so the last safe sequence stays safe without it.
+    // Declare variables
+    int position;
+    int lastIndex = processCount - 1;
+
+    // Error Checking
+    if (needed == NULL || processIndex < 0 || processIndex >= processCount || processCount == 1) return REQUEST_INVALID;
+
+    // Drop the process from the safe sequence, renaming the last process as it moves
+    if (safeSequenceValid)
+    {
+        position = sequencePosition[processIndex];
+        memmove(safeSequence + position, safeSequence + position + 1, (lastIndex - position) * sizeof(int));
+        for (position = 0; position < lastIndex; position++)
+        {
+            if (safeSequence[position] == lastIndex) safeSequence[position] = processIndex;
+            sequencePosition[safeSequence[position]] = position;
+        }
+    }
+
+    SwapRemoveProcess(processIndex);
+    detectionValid = 0;
+    return REQUEST_GRANTED;
+}
+
+int AddResourceType(int units)
+{
+    // Adds a resource type with units free that no process claims yet; returns a REQUEST_* code.
+    // Nobody needs the new type, so the last safe sequence and deadlock detection both still hold.
+    // Error Checking
+    if (needed == NULL || units <= 0) return REQUEST_INVALID;
+
+    AppendResourceType(units);
+    return REQUEST_GRANTED;
+}
+
+int UpdateProcess(int processIndex, const int* maxRow, const int* allocatedRow)
+{
+    // Replaces a process's max claim and allocation (resourceCount values each); returns a REQUEST_* code.
+    // If neither its need nor its allocation grows, everyone ahead of it has at least as much to work with
+    // and everyone after it the same, so the last safe sequence still holds.
+    // Declare variables
+    int keepsSequence;
+
+    // Error Checking
+    if (needed == NULL || processIndex < 0 || processIndex >= processCount || !IsVectorInRange(maxRow)
+        || !IsVectorInRange(allocatedRow))
+        return REQUEST_INVALID;
+    if (FindShortfall(allocatedRow, maxRow, resourceCount) < resourceCount) return REQUEST_EXCEEDS_CLAIM;
+    memcpy(requestWork, available, resourceCount * sizeof(int));
+    AddRow(requestWork, MatrixRow(allocated, processIndex), resourceCount);
+    if (FindShortfall(allocatedRow, requestWork, resourceCount) < resourceCount) return REQUEST_MUST_WAIT;
+
+    // See whether the new need and allocation both fit inside the old ones
+    memcpy(requestWork, maxRow, resourceCount * sizeof(int));
+    SubtractRow(requestWork, allocatedRow, resourceCount);
+    keepsSequence = FindShortfall(requestWork, MatrixRow(needed, processIndex), resourceCount) == resourceCount
+                    && FindShortfall(allocatedRow, MatrixRow(allocated, processIndex), resourceCount) == resourceCount;
+
+    SetProcessAllocation(processIndex, allocatedRow);
+    SetProcessMax(processIndex, maxRow);
+
+    if (!keepsSequence) safeSequenceValid = 0;
+    detectionValid = 0;
+    return REQUEST_GRANTED;
+}
+
+/***************************************************************/
+unsigned int JournalChecksum(int operation, int processIndex, const int* values, int count)
+{
+    // FNV-1a over the record's fields and values
+    // Declare variables
+    int resourceIndex;
+    unsigned int hash = 2166136261u;
+
+    hash = (hash ^ (unsigned int) operation) * 16777619u;
+    hash = (hash ^ (unsigned int) processIndex) * 16777619u;
+    for (resourceIndex = 0; resourceIndex < count; resourceIndex++)
+    {
+        hash = (hash ^ (unsigned int) values[resourceIndex]) * 16777619u;
+    }
+
+    return hash;
+}
+
+void PersistencePath(char* path, const char* name, int generation)
+{
+    snprintf(path, 1024, "%s/%s.%d", persistence.directory, name, generation);
+}
+
+void JournalAppend(int operation, int processIndex, const int* values)
+{
+    // Queues one record of resourceCount values (call it after a JOURNAL_ADD_RESOURCE change, so the new
+    // type is counted); nothing reaches the disk until JournalCommit.
+    // Declare variables
+    size_t size = sizeof(struct JournalRecord) + resourceCount * sizeof(int);
+    struct JournalRecord record;
+
+    if (!persistence.isOpen || persistence.journal < 0) return;
+
+    // Make room
+    if (persistence.pendingSize + size > persistence.pendingCapacity)
+    {
+        persistence.pendingCapacity = (persistence.pendingSize + size) * 2;
+        persistence.pending = realloc(persistence.pending, persistence.pendingCapacity);
+    }
+
+    // Copy the record in
+    record.operation = operation;
+    record.processIndex = processIndex;
+    record.checksum = JournalChecksum(operation, processIndex, values, resourceCount);
+    memcpy(persistence.pending + persistence.pendingSize, &record, sizeof(record));
+    memcpy(persistence.pending + persistence.pendingSize + sizeof(record), values, resourceCount * sizeof(int));
+    persistence.pendingSize += size;
+    persistence.recordCount++;
+}
+
+int CheckpointState()
+{
+    // Writes the whole state as the next generation's checkpoint and starts an empty journal for it, then drops
+    // the previous generation. A crash at any point leaves either the old pair or the new one to recover from,
+    // and a journal is only ever replayed onto the checkpoint of its own generation. Returns whether it worked.
+    // Declare variables
+    int next = persistence.generation + 1;
+    int journal;
+    int directory;
+    int isPublished;
+    char temporary[1024];
+    char path[1024];
+    struct JournalHeader header;
+
+    if (!persistence.isOpen || needed == NULL) return 0;
+
+    // Write the checkpoint under a temporary name, and the header of its empty journal
+    snprintf(temporary, sizeof(temporary), "%s/checkpoint.tmp", persistence.directory);
+    PersistencePath(path, "journal", next);
+    memcpy(header.magic, JOURNAL_MAGIC, 4);
+    header.generation = next;
+    header.resourceCount = resourceCount;
+    journal = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (journal < 0 || !SaveStateFile(temporary) || !WriteAll(journal, &header, sizeof(header)) || fdatasync(journal) != 0)
+    {
+        printf("ERROR: Could not write a checkpoint to %s!\n", persistence.directory);
+        if (journal >= 0) close(journal);
+        return 0;
+    }
+
+    // Publish the checkpoint, and make the rename itself durable; until both worked the old generation is kept
+    PersistencePath(path, "checkpoint", next);
+    isPublished = rename(temporary, path) == 0;
+    directory = open(persistence.directory, O_RDONLY);
+    isPublished = isPublished && directory >= 0 && fsync(directory) == 0;
+    if (directory >= 0) close(directory);
+    if (!isPublished)
+    {
+        printf("ERROR: Could not publish a checkpoint in %s!\n", persistence.directory);
+        close(journal);
+        unlink(temporary);
+        unlink(path);
+        PersistencePath(path, "journal", next);
+        unlink(path);
+        return 0;
+    }
+
+    // Retire the previous generation
+    if (persistence.journal >= 0) close(persistence.journal);
+    PersistencePath(path, "checkpoint", persistence.generation);
+    unlink(path);
+    PersistencePath(path, "journal", persistence.generation);
+    unlink(path);
+    persistence.journal = journal;
+    persistence.generation = next;
+    persistence.pendingSize = 0;
+    persistence.recordCount = 0;
+    persistence.journalSize = sizeof(header);
+    persistence.isTorn = 0;
+    return 1;
+}
+
+int JournalCommit()
+{
+    // Writes every queued record with one write and one sync, so a whole batch of changes costs one disk flush.
+    // Returns 0 if they didn't all reach the disk: the queued records are dropped and the journal is cut back
+    // to what was there, and the caller must undo the changes before acknowledging them.
+    // Checkpoints instead of letting the journal grow past JOURNAL_CHECKPOINT_RECORDS, or if it may be torn.
+    if (!persistence.isOpen || persistence.journal < 0 || persistence.pendingSize == 0) return 1;
+
+    // A checkpoint holds every change made so far, so it stands in for the records
+    if (persistence.isTorn)
+    {
+        if (CheckpointState()) return 1;
+        persistence.pendingSize = 0;
+        return 0;
+    }
+
+    if (!WriteAll(persistence.journal, persistence.pending, persistence.pendingSize) || fdatasync(persistence.journal) != 0)
+    {
+        printf("ERROR: Could not write the journal in %s!\n", persistence.directory);
+        persistence.isTorn = ftruncate(persistence.journal, persistence.journalSize) != 0;
+        persistence.pendingSize = 0;
+        return 0;
+    }
+    persistence.journalSize += (off_t) persistence.pendingSize;
+    persistence.pendingSize = 0;
+    persistence.commitCount++;
+
+    if (persistence.recordCount >= JOURNAL_CHECKPOINT_RECORDS) CheckpointState();
+    return 1;
+}
+
+int ApplyJournalRecord(const struct JournalRecord* record, const int* values)
+{
+    // Redoes one journalled change; returns 0 if it makes no sense for the state it's applied to.
+    // Declare variables
+    int isProcessValid = record->processIndex >= 0 && record->processIndex < processCount;
+
+    switch (record->operation)
+    {
+        case JOURNAL_REQUEST:
+            if (CheckRequest(record->processIndex, values) != REQUEST_GRANTED) return 0;
+            GrantResources(record->processIndex, values);
+            return 1;
+        case JOURNAL_RELEASE:
+            return ReleaseResources(record->processIndex, values) == REQUEST_GRANTED;
+        case JOURNAL_ADD_PROCESS:
+            if (record->processIndex != processCount || !IsVectorInRange(values)) return 0;
+            AppendProcess(values);
+            return 1;
+        case JOURNAL_REMOVE_PROCESS:
+            if (!isProcessValid || processCount == 1) return 0;
+            SwapRemoveProcess(record->processIndex);
+            return 1;
+        case JOURNAL_ADD_RESOURCE:
+            if (record->processIndex != resourceCount || values[resourceCount] <= 0) return 0;
+            AppendResourceType(values[resourceCount]);
+            return 1;
+        case JOURNAL_SET_MAX:
+            if (!isProcessValid || !IsVectorInRange(values)) return 0;
+            SetProcessMax(record->processIndex, values);
+            return 1;
+        case JOURNAL_SET_ALLOCATED:
+            if (!isProcessValid || !IsVectorInRange(values)) return 0;
+            SetProcessAllocation(record->processIndex, values);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+long long ReplayJournal(const char* path)
+{
+    // Applies every intact record of a journal to the freshly loaded checkpoint; returns how many were applied.
+    // Stops at the first torn or nonsensical record, since nothing after it can have been acknowledged.
+    // Declare variables
+    long long applied = 0;
+    int valueCount;
+    size_t size;
+    size_t offset;
+    size_t recordSize;
+    int* values = malloc((resourceCount + 1) * sizeof(int));
+    const char* data = MapFile(path, &size);
+    struct JournalHeader header;
+    struct JournalRecord record;
+
+    // Check the journal belongs to this checkpoint
+    if (data == NULL || size < sizeof(header))
+    {
+        free(values);
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, 4) != 0 || header.generation != persistence.generation
+        || header.resourceCount != resourceCount)
+    {
+        printf("ERROR: Journal %s does not match its checkpoint!\n", path);
+        offset = size;
+    }
+    else offset = sizeof(header);
+
+    // Apply each record in turn, sizing each by the resource count at that point
+    for (; offset + sizeof(record) <= size; offset += recordSize, applied++)
+    {
+        memcpy(&record, data + offset, sizeof(record));
+        valueCount = record.operation == JOURNAL_ADD_RESOURCE ? resourceCount + 1 : resourceCount;
+        recordSize = sizeof(record) + valueCount * sizeof(int);
+        if (offset + recordSize > size) break;
+        memcpy(values, data + offset + sizeof(record), valueCount * sizeof(int));
+        if (record.checksum != JournalChecksum(record.operation, record.processIndex, values, valueCount)
+            || !ApplyJournalRecord(&record, values))
+            break;
+        if (record.operation == JOURNAL_ADD_RESOURCE) values = realloc(values, (resourceCount + 1) * sizeof(int));
+    }
+
+    munmap((void*) data, size);
+    free(values);
+    return applied;
+}
+
+int OpenPersistence(const char* directory)
+{
+    // Keeps the state in directory from now on, first recovering the newest checkpoint and its journal if
+    // there is one; returns whether a state was recovered.
+    // Declare variables
+    int generation;
+    long long applied;
+    char path[1024];
+    double start = NowSeconds();
+    DIR* listing;
+    struct dirent* entry;
+    struct stat journalStatus;
+
+    // Claim the directory, then find the newest checkpoint
+    mkdir(directory, 0755);
+    snprintf(path, sizeof(path), "%s/lock", directory);
+    persistence.lock = open(path, O_RDWR | O_CREAT, 0644);
+    listing = opendir(directory);
+    if (persistence.lock < 0 || flock(persistence.lock, LOCK_EX | LOCK_NB) != 0 || listing == NULL)
+    {
+        printf("ERROR: Could not open state directory %s, or another process is using it!\n", directory);
+        if (persistence.lock >= 0) close(persistence.lock);
+        if (listing != NULL) closedir(listing);
+        return 0;
+    }
+    persistence.isOpen = 1;
+    snprintf(persistence.directory, sizeof(persistence.directory), "%s", directory);
+    persistence.generation = 0;
+    persistence.journal = -1;
+    while ((entry = readdir(listing)) != NULL)
+    {
+        if (sscanf(entry->d_name, "checkpoint.%d", &generation) == 1 && generation > persistence.generation)
+            persistence.generation = generation;
+    }
+    closedir(listing);
+    if (persistence.generation == 0) return 0;
+
+    // Load it and replay whatever followed it
+    PersistencePath(path, "checkpoint", persistence.generation);
+    if (!LoadStateFile(path)) return 0;
+    PersistencePath(path, "journal", persistence.generation);
+    applied = ReplayJournal(path);
+    printf("Recovered %d processes x %d resources from generation %d plus %lld journal record(s) in %.3f ms\n",
+           processCount, resourceCount, persistence.generation, applied, (NowSeconds() - start) * 1000);
+
+    // Carry on with an empty journal as it is, otherwise fold it into a fresh checkpoint so the next start is just a load
+    if (applied == 0 && stat(path, &journalStatus) == 0 && journalStatus.st_size == sizeof(struct JournalHeader))
+    {
+        persistence.journal = open(path, O_WRONLY | O_APPEND);
+        persistence.journalSize = journalStatus.st_size;
+        if (persistence.journal >= 0) return 1;
+    }
+    if (!CheckpointState())
+    {
+        FreeState();
+        close(persistence.lock);
+        persistence.isOpen = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void ClosePersistence()
+{
+    // Commits anything queued and leaves a checkpoint of the final state.
+    if (!persistence.isOpen) return;
+    JournalCommit();
+    if (persistence.recordCount > 0) CheckpointState();
+    if (persistence.journal >= 0) close(persistence.journal);
+    close(persistence.lock);
+    free(persistence.pending);
+    memset(&persistence, 0, sizeof(persistence));
+}
+
+/***************************************************************/
+int TakeProcessVector(const char* action, int* vector)
+{
+    // Reads a process index followed by one count per resource; returns the process index.
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+
+    printf("Enter process to %s for: ", action);
+    scanf("%d", &processIndex);
+    printf("Enter number of units of each resource (r0 to r%d) to %s: ", resourceCount - 1, action);
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        scanf("%d", &vector[resourceIndex]);
+    }
+    // Clear the input
+    fflush(stdin);
+
+    return processIndex;
+}
+
+void TakeRequest(int isRelease)
+{
+    // Declare variables
+    int processIndex;
+    int result;
+    int* vector;
+
+    // Make sure there's a state to change
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    // Take the process and vector, then apply it
+    vector = AllocateMatrix(1);
+    processIndex = TakeProcessVector(isRelease ? "release" : "request", vector);
+    if (isRelease) result = ReleaseResources(processIndex, vector);
+    else result = RequestResources(processIndex, vector);
+
+    // Make the change durable before reporting it, undoing it if that failed
+    if (result == REQUEST_GRANTED)
+    {
+        JournalAppend(isRelease ? JOURNAL_RELEASE : JOURNAL_REQUEST, processIndex, vector);
+        if (!JournalCommit())
+        {
+            if (isRelease) GrantResources(processIndex, vector);
+            else ReturnResources(processIndex, vector);
+            safeSequenceValid = 0;
+            detectionValid = 0;
+            result = REQUEST_NOT_SAVED;
+        }
+    }
+    FreeAligned(vector);
+
+    // Print the outcome and the resulting tables
+    printf("\n%s %s", isRelease ? "Release" : "Request", requestMessages[result]);
+    if (result == REQUEST_GRANTED)
+    {
+        PrintResources();
+        PrintProcesses();
+    }
+}
+
+void TakeStateChange()
+{
+    // Declare variables
+    int change;
+    int processIndex = 0;
+    int resourceIndex;
+    int units;
+    int result;
+    int lastIndex;
+    int* maxRow;
+    int* allocatedRow;
+    int* oldRows;
+
+    // Make sure there's a state to change
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    printf("Enter change (0=add process, 1=remove process, 2=add resource type, 3=update process): ");
+    scanf("%d", &change);
+    if (change == 1 || change == 3)
+    {
+        printf("Enter process: ");
+        scanf("%d", &processIndex);
+    }
+
+    // Take the vectors the change needs, then apply it
+    maxRow = AllocateMatrix(1);
+    allocatedRow = AllocateMatrix(1);
+    if (change == 0 || change == 3)
+    {
+        printf("Enter maximum number of units of each resource (r0 to r%d) the process will request: ", resourceCount - 1);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            scanf("%d", &maxRow[resourceIndex]);
+        }
+        printf("Enter number of units of each resource (r0 to r%d) allocated to the process: ", resourceCount - 1);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            scanf("%d", &allocatedRow[resourceIndex]);
+        }
+    }
+    if (change == 2)
+    {
+        printf("Enter number of units of the new resource: ");
+        scanf("%d", &units);
+    }
+    // Clear the input
+    fflush(stdin);
+
+    // Keep what a removal or update replaces, in case it has to be undone
+    oldRows = AllocateMatrix(3);
+    if ((change == 1 || change == 3) && processIndex >= 0 && processIndex < processCount)
+    {
+        memcpy(MatrixRow(oldRows, 0), MatrixRow(maxClaim, processIndex), rowStride * sizeof(int));
+        memcpy(MatrixRow(oldRows, 1), MatrixRow(allocated, processIndex), rowStride * sizeof(int));
+        memcpy(MatrixRow(oldRows, 2), MatrixRow(requested, processIndex), rowStride * sizeof(int));
+    }
+
+    if (change == 0) result = AddProcess(maxRow, allocatedRow);
+    else if (change == 1) result = RemoveProcess(processIndex);
+    else if (change == 2) result = AddResourceType(units);
+    else if (change == 3) result = UpdateProcess(processIndex, maxRow, allocatedRow);
+    else result = REQUEST_INVALID;
+
+    // Make the change durable before reporting it
+    if (result == REQUEST_GRANTED)
+    {
+        if (change == 0) JournalAppend(JOURNAL_ADD_PROCESS, processCount - 1, maxRow);
+        if (change == 0 && !IsRowEmpty(allocatedRow)) JournalAppend(JOURNAL_SET_ALLOCATED, processCount - 1, allocatedRow);
+        if (change == 1) JournalAppend(JOURNAL_REMOVE_PROCESS, processIndex, resources);
+        if (change == 2) JournalAppend(JOURNAL_ADD_RESOURCE, resourceCount - 1, resources);
+        if (change == 3) JournalAppend(JOURNAL_SET_ALLOCATED, processIndex, allocatedRow);
+        if (change == 3) JournalAppend(JOURNAL_SET_MAX, processIndex, maxRow);
+        if (!JournalCommit()) result = REQUEST_NOT_SAVED;
+    }
+
+    // Undo a change that couldn't be made durable
+    if (result == REQUEST_NOT_SAVED && change == 0) SwapRemoveProcess(processCount - 1);
+    if (result == REQUEST_NOT_SAVED && change == 1)
+    {
+        // Move the process now at processIndex back to the end, then put the removed one back in its place
+        lastIndex = processCount;
+        AppendProcess(MatrixRow(maxClaim, processIndex));
+        SetProcessAllocation(lastIndex, MatrixRow(allocated, processIndex));
+        memcpy(MatrixRow(requested, lastIndex), MatrixRow(requested, processIndex), rowStride * sizeof(int));
+        SetProcessAllocation(processIndex, MatrixRow(oldRows, 1));
+        SetProcessMax(processIndex, MatrixRow(oldRows, 0));
+        memcpy(MatrixRow(requested, processIndex), MatrixRow(oldRows, 2), rowStride * sizeof(int));
+    }
+    if (result == REQUEST_NOT_SAVED && change == 2)
+    {
+        resourceCount--;
+        resources[resourceCount] = 0;
+        available[resourceCount] = 0;
+        detectionWork[resourceCount] = 0;
+    }
+    if (result == REQUEST_NOT_SAVED && change == 3)
+    {
+        SetProcessAllocation(processIndex, MatrixRow(oldRows, 1));
+        SetProcessMax(processIndex, MatrixRow(oldRows, 0));
+    }
+    if (result == REQUEST_NOT_SAVED)
+    {
+        safeSequenceValid = 0;
+        detectionValid = 0;
+    }
+    FreeAligned(maxRow);
+    FreeAligned(allocatedRow);
+    FreeAligned(oldRows);
+
+    // Print the outcome and the resulting tables
+    printf("\nChange %s", requestMessages[result]);
+    if (result == REQUEST_GRANTED)
+    {
+        PrintResources();
+        PrintProcesses();
+    }
+}
+
+/***************************************************************/
+void PublishAvailable()
+{
+    // Copies available into the snapshot; the caller must hold manager.lock.
+    // Declare variables
+    int resourceIndex;
+    unsigned int version = atomic_load_explicit(&manager.version, memory_order_relaxed);
+
+    // Mark the snapshot as changing, rewrite it, then mark it stable again
+    atomic_store_explicit(&manager.version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        atomic_store_explicit(&manager.snapshot[resourceIndex], available[resourceIndex], memory_order_relaxed);
+    }
+    atomic_store_explicit(&manager.version, version + 2, memory_order_release);
+}
+
+void OpenResourceManager()
+{
+    // Starts serving concurrent requests against the current state, which nothing else may touch until closed.
+    pthread_mutex_init(&manager.lock, NULL);
+    atomic_init(&manager.version, 0);
+    manager.snapshot = malloc((resourceCount > 0 ? resourceCount : 1) * sizeof(atomic_int));
+    manager.isOpen = 1;
+    PublishAvailable();
+}
+
+void CloseResourceManager()
+{
+    if (!manager.isOpen) return;
+    pthread_mutex_destroy(&manager.lock);
+    free(manager.snapshot);
+    manager.snapshot = NULL;
+    manager.isOpen = 0;
+}
+
+int ManagerRequest(int processIndex, const int* request)
+{
+    // RequestResources, safe to call from any thread; returns a REQUEST_* code.
+    // Declare variables
+    int result;
+
+    pthread_mutex_lock(&manager.lock);
+    result = RequestResources(processIndex, request);
+    if (result == REQUEST_GRANTED) PublishAvailable();
+    pthread_mutex_unlock(&manager.lock);
+
+    return result;
+}
+
+int ManagerRelease(int processIndex, const int* release)
+{
+    // ReleaseResources, safe to call from any thread; returns a REQUEST_* code.
+    // Declare variables
+    int result;
+
+    pthread_mutex_lock(&manager.lock);
+    result = ReleaseResources(processIndex, release);
+    if (result == REQUEST_GRANTED) PublishAvailable();
+    pthread_mutex_unlock(&manager.lock);
+
+    return result;
+}
+
+int ReadAvailableSnapshot(int* target)
+{
+    // Copies a consistent available vector without taking the lock; returns how many times it had to retry.
+    // Declare variables
+    int resourceIndex;
+    int retries = -1;
+    unsigned int before;
+    unsigned int after;
+
+    // Copy until no publish started or finished during the copy
+    do
+    {
+        retries++;
+        before = atomic_load_explicit(&manager.version, memory_order_acquire);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            target[resourceIndex] = atomic_load_explicit(&manager.snapshot[resourceIndex], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&manager.version, memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+    return retries;
+}
+
+/***************************************************************/
+void FileDetectionWaiter(int processIndex)
+{
+    // Tests a process that couldn't finish against detectionWork again: it either joins the end of
+    // detectionSequence, or waits on the first resource it is still short of.
+    // Declare variables
+    int resourceIndex = FindShortfall(MatrixRow(requested, processIndex), detectionWork, rowStride);
+
+    if (resourceIndex == rowStride)
+    {
+        detectionPosition[processIndex] = detectionFinished;
+        detectionSequence[detectionFinished++] = processIndex;
+        return;
+    }
+    detectionWaitingOn[processIndex] = resourceIndex;
+    detectionNextWaiter[processIndex] = detectionWaiters[resourceIndex];
+    detectionWaiters[resourceIndex] = processIndex + 1;
+}
+
+void UnfileDetectionWaiter(int processIndex)
+{
+    // Takes a process that couldn't finish off the list of the resource it waits on.
+    // Declare variables
+    int* link = &detectionWaiters[detectionWaitingOn[processIndex]];
+
+    while (*link != processIndex + 1) link = &detectionNextWaiter[*link - 1];
+    *link = detectionNextWaiter[processIndex];
+}
+
+void RunDeadlockDetection()
+{
+    // Finds every process whose outstanding request can eventually be met, by running the event-driven
+    // solver against the request matrix instead of the need matrix.
+    // Declare variables
+    int position;
+    int processIndex;
+
+    // Sequence whoever can finish
+    detectionFinished = EventDrivenSafeSequence(requested, available, detectionSequence);
+
+    // Index the result and total what they hand back
+    memcpy(detectionWork, available, rowStride * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        detectionPosition[processIndex] = -1;
+    }
+    for (position = 0; position < detectionFinished; position++)
+    {
+        processIndex = detectionSequence[position];
+        detectionPosition[processIndex] = position;
+        AddRow(detectionWork, MatrixRow(allocated, processIndex), rowStride);
+    }
+
+    // List everyone else under the resource they are still short of
+    memset(detectionWaiters, 0, rowStride * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        if (detectionPosition[processIndex] < 0) FileDetectionWaiter(processIndex);
+    }
+    detectionValid = 1;
+}
+
+void ResumeDeadlockDetection(int head)
+{
+    // Carries the last detection on from detectionSequence[head], the first process whose release hasn't
+    // been handed out yet. Each release only tests again the processes waiting on a resource it grew.
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    int waiter;
+    const int* row;
+
+    while (head < detectionFinished)
+    {
+        processIndex = detectionSequence[head++];
+        row = MatrixRow(allocated, processIndex);
+        AddRow(detectionWork, row, rowStride);
+
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            if (row[resourceIndex] == 0) continue;
+
+            // Take this resource's waiters and file each again
+            waiter = detectionWaiters[resourceIndex];
+            detectionWaiters[resourceIndex] = 0;
+            while (waiter > 0)
+            {
+                processIndex = waiter - 1;
+                waiter = detectionNextWaiter[processIndex];
+                FileDetectionWaiter(processIndex);
+            }
+        }
+    }
+}
+
+int SetOutstandingRequest(int processIndex, const int* request)
+{
+    // Replaces a process's outstanding request (resourceCount values) and updates the last detection
+    // incrementally where it can; returns a REQUEST_* code.
+    // Declare variables
+    int position;
+    int fits;
+
+    // Error Checking
+    if (requested == NULL || processIndex < 0 || processIndex >= processCount || !IsVectorInRange(request))
+        return REQUEST_INVALID;
+
+    memcpy(MatrixRow(requested, processIndex), request, resourceCount * sizeof(int));
+    if (!detectionValid) return REQUEST_GRANTED;
+
+    if (detectionPosition[processIndex] < 0)
+    {
+        // A blocked process may now wait on another resource, or finish and unblock whoever waits on what it holds
+        position = detectionFinished;
+        UnfileDetectionWaiter(processIndex);
+        FileDetectionWaiter(processIndex);
+        ResumeDeadlockDetection(position);
+    }
+    else
+    {
+        // A process that could finish still can if its new request fits what its predecessors leave
+        memcpy(requestWork, available, rowStride * sizeof(int));
+        for (position = 0; position < detectionPosition[processIndex]; position++)
+        {
+            AddRow(requestWork, MatrixRow(allocated, detectionSequence[position]), rowStride);
+        }
+        fits = FindShortfall(MatrixRow(requested, processIndex), requestWork, rowStride) == rowStride;
+        if (!fits) detectionValid = 0;
+    }
+
+    return REQUEST_GRANTED;
+}
+
+int IsProcessDeadlocked(int processIndex)
+{
+    // A process is deadlocked if it couldn't finish and holds something others may be waiting on
+    return detectionPosition[processIndex] < 0 && !IsRowEmpty(MatrixRow(allocated, processIndex));
+}
+
+int DetectDeadlock()
+{
+    // Brings the detection up to date; returns the number of deadlocked processes.
+    // Declare variables
+    int processIndex;
+    int deadlockedCount = 0;
+
+    if (!detectionValid) RunDeadlockDetection();
+
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        if (IsProcessDeadlocked(processIndex)) deadlockedCount++;
+    }
+
+    return deadlockedCount;
+}
+
+void TakeOutstandingRequest()
+{
+    // Declare variables
+    int processIndex;
+    int result;
+    int* vector;
+
+    // Make sure there's a state to change
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    // Take the process and vector, then record it
+    vector = AllocateMatrix(1);
+    processIndex = TakeProcessVector("wait", vector);
+    result = SetOutstandingRequest(processIndex, vector);
+    printf("\nOutstanding request %s", result == REQUEST_GRANTED ? "recorded" : requestMessages[result]);
+    FreeAligned(vector);
+}
+
+void PrintDeadlock()
+{
+    // Declare variables
+    int processIndex;
+    int deadlockedCount;
+
+    // Make sure there's a state to check
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    deadlockedCount = DetectDeadlock();
+    if (reportVerbosity < REPORT_SUMMARY) return;
+
+    // Print the deadlocked processes, if any
+    if (deadlockedCount == 0)
+    {
+        ReportText("\nNo deadlock detected.");
+    }
+    else
+    {
+        ReportText("\nDeadlocked processes: <");
+        for (processIndex = 0; processIndex < processCount; processIndex++)
+        {
+            if (!IsProcessDeadlocked(processIndex)) continue;
+            ReportText(" p");
+            ReportInt(processIndex);
+        }
+        ReportText(" >");
+    }
+    ReportFlush();
+}
+
+/***************************************************************/
+// Safe sequence search: the available resources only depend on which processes have finished, not the order
+// they finished in, so every question about safe orders is a walk over completed sets memoised on a bitmask.
+void InitSearchTable(struct SearchTable* table, long long capacity)
+{
+    table->capacity = capacity;
+    table->used = 0;
+    table->isFull = 0;
+    table->keys = malloc(capacity * sizeof(unsigned long long));
+    table->counts = malloc(capacity * sizeof(unsigned long long));
+    table->steps = malloc(capacity * sizeof(int));
+    table->flags = calloc(capacity, 1);
+}
+
+void FreeSearchTable(struct SearchTable* table)
+{
+    free(table->keys);
+    free(table->counts);
+    free(table->steps);
+    free(table->flags);
+}
+
+long long ProbeSearchTable(const struct SearchTable* table, unsigned long long completed)
+{
+    // Returns the slot holding completed, or the empty slot it would go in.
+    // Declare variables
+    long long slot = (long long) ((completed * 0x9E3779B97F4A7C15ULL) >> 20) & (table->capacity - 1);
+
+    while (table->flags[slot] != 0 && table->keys[slot] != completed) slot = (slot + 1) & (table->capacity - 1);
+    return slot;
+}
+
+long long FindSearchSlot(struct SearchTable* table, unsigned long long completed)
+{
+    // Returns the slot holding completed, claiming one (and growing the table) if it isn't there yet.
+    // Returns -1 if claiming one would take the table past SEARCH_TABLE_LIMIT.
+    // Declare variables
+    long long slot = ProbeSearchTable(table, completed);
+    long long oldSlot;
+    struct SearchTable grown;
+
+    if (table->flags[slot] != 0) return slot;
+
+    // Double the table once it's half full, re-inserting everything
+    if ((table->used + 1) * 2 > table->capacity)
+    {
+        if (table->capacity * 2 > SEARCH_TABLE_LIMIT)
+        {
+            table->isFull = 1;
+            return -1;
+        }
+        InitSearchTable(&grown, table->capacity * 2);
+        for (oldSlot = 0; oldSlot < table->capacity; oldSlot++)
+        {
+            if (table->flags[oldSlot] == 0) continue;
+            slot = ProbeSearchTable(&grown, table->keys[oldSlot]);
+            grown.keys[slot] = table->keys[oldSlot];
+            grown.counts[slot] = table->counts[oldSlot];
+            grown.steps[slot] = table->steps[oldSlot];
+            grown.flags[slot] = table->flags[oldSlot];
+        }
+        grown.used = table->used;
+        FreeSearchTable(table);
+        *table = grown;
+        slot = ProbeSearchTable(table, completed);
+    }
+
+    // Claim it with nothing filled in yet
+    table->keys[slot] = completed;
+    table->flags[slot] = SEARCH_SLOT_USED;
+    table->used++;
+    return slot;
+}
+
+unsigned long long SaturatingAdd(unsigned long long left, unsigned long long right)
+{
+    return left > ~0ULL - right ? ~0ULL : left + right;
+}
+
+unsigned long long SaturatingFactorial(int count)
+{
+    // Declare variables
+    unsigned long long product = 1;
+
+    for (; count > 1; count--)
+    {
+        if (product > ~0ULL / (unsigned long long) count) return ~0ULL;
+        product *= (unsigned long long) count;
+    }
+
+    return product;
+}
+
+unsigned long long RunnableSet(unsigned long long completed, const int* work)
+{
+    // The unfinished processes whose whole need fits in work.
+    // Declare variables
+    int processIndex;
+    unsigned long long runnable = 0;
+
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        if ((completed >> processIndex & 1) == 0
+            && FindShortfall(MatrixRow(needed, processIndex), work, rowStride) == rowStride)
+            runnable |= 1ULL << processIndex;
+    }
+
+    return runnable;
+}
+
+int CountSetBits(unsigned long long mask)
+{
+    // Declare variables
+    int count = 0;
+
+    for (; mask != 0; mask &= mask - 1) count++;
+    return count;
+}
+
+unsigned long long CountSafeCompletions(struct SearchTable* table, unsigned long long completed, int remaining, int* work)
+{
+    // Counts the safe orders that finish every process not in completed, with work holding what's available
+    // once completed have finished. If everyone left can already run, every order of them is safe.
+    // Declare variables
+    int processIndex;
+    int runnableCount;
+    long long slot;
+    unsigned long long runnable;
+    unsigned long long total = 0;
+
+    if (remaining == 0) return 1;
+    slot = FindSearchSlot(table, completed);
+    if (slot < 0) return 0;
+    if (table->flags[slot] & SEARCH_COUNT_KNOWN) return table->counts[slot];
+
+    // Branch on each process that can run now, unless they all can
+    runnable = RunnableSet(completed, work);
+    runnableCount = CountSetBits(runnable);
+    if (runnableCount == remaining) total = SaturatingFactorial(remaining);
+    for (processIndex = 0; processIndex < processCount && runnableCount < remaining && !table->isFull; processIndex++)
+    {
+        if ((runnable >> processIndex & 1) == 0) continue;
+        AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+        total = SaturatingAdd(total, CountSafeCompletions(table, completed | 1ULL << processIndex, remaining - 1, work));
+        SubtractRow(work, MatrixRow(allocated, processIndex), rowStride);
+    }
+
+    // The table may have grown while branching, so find the slot again before filling it in
+    slot = ProbeSearchTable(table, completed);
+    table->counts[slot] = total;
+    table->flags[slot] |= SEARCH_COUNT_KNOWN;
+    return total;
+}
+
+unsigned long long TargetCandidates(unsigned long long completed, unsigned long long targets, const int* work)
+{
+    // The processes worth running next on the way to the targets. Two kinds of branch are dominated and
+    // skipped: a target that can run now is always run at once, since finishing it only frees resources;
+    // and a process holding nothing is never run before the targets, since finishing it frees nothing.
+    // Declare variables
+    int processIndex;
+    unsigned long long runnable = RunnableSet(completed, work);
+    unsigned long long candidates = runnable & targets;
+
+    if (candidates != 0) return candidates & ~(candidates - 1);
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        if ((runnable >> processIndex & 1) && !IsRowEmpty(MatrixRow(allocated, processIndex)))
+            candidates |= 1ULL << processIndex;
+    }
+
+    return candidates;
+}
+
+int FewestStepsToTargets(struct SearchTable* table, unsigned long long completed, unsigned long long targets, int* work)
+{
+    // Returns the fewest further processes that must finish, from completed, before every target has finished
+    // (-1 if they can't all finish), trying only the TargetCandidates at each step.
+    // Declare variables
+    int processIndex;
+    int steps;
+    int best = -1;
+    long long slot;
+    unsigned long long candidates;
+
+    if ((completed & targets) == targets) return 0;
+    slot = FindSearchSlot(table, completed);
+    if (slot < 0) return -1;
+    if (table->flags[slot] & SEARCH_STEPS_KNOWN) return table->steps[slot];
+
+    // Take the best of the branches worth trying
+    candidates = TargetCandidates(completed, targets, work);
+    for (processIndex = 0; processIndex < processCount && !table->isFull; processIndex++)
+    {
+        if ((candidates >> processIndex & 1) == 0) continue;
+        AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+        steps = FewestStepsToTargets(table, completed | 1ULL << processIndex, targets, work);
+        SubtractRow(work, MatrixRow(allocated, processIndex), rowStride);
+        if (steps >= 0 && (best < 0 || steps + 1 < best)) best = steps + 1;
+    }
+
+    slot = ProbeSearchTable(table, completed);
+    table->steps[slot] = best;
+    table->flags[slot] |= SEARCH_STEPS_KNOWN;
+    return best;
+}
+
+int EarliestTargetSequence(unsigned long long targets, int* sequence, int* targetSteps)
+{
+    // Builds a safe sequence that finishes every target as early as possible, writing how many processes run
+    // up to the last target to targetSteps (-1 if the targets can't all finish); returns the sequence length,
+    // or -1 (with targetSteps -1) if the search grew past SEARCH_TABLE_LIMIT.
+    // Declare variables
+    int processIndex;
+    int steps;
+    int length = 0;
+    unsigned long long completed = 0;
+    unsigned long long candidates;
+    int* work = AllocateMatrix(1);
+    struct SearchTable table;
+
+    // Solve for the fewest steps, then follow a candidate that achieves it at every step
+    InitSearchTable(&table, 1024);
+    memcpy(work, available, rowStride * sizeof(int));
+    *targetSteps = FewestStepsToTargets(&table, 0, targets, work);
+    while (*targetSteps >= 0 && !table.isFull && (completed & targets) != targets)
+    {
+        steps = FewestStepsToTargets(&table, completed, targets, work);
+        candidates = TargetCandidates(completed, targets, work);
+        for (processIndex = 0; processIndex < processCount; processIndex++)
+        {
+            if ((candidates >> processIndex & 1) == 0) continue;
+            AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+            if (FewestStepsToTargets(&table, completed | 1ULL << processIndex, targets, work) == steps - 1) break;
+            SubtractRow(work, MatrixRow(allocated, processIndex), rowStride);
+        }
+        // Every step was solved on the way down, so no match means the table filled up and lost some of them
+        if (processIndex == processCount) break;
+        completed |= 1ULL << processIndex;
+        sequence[length++] = processIndex;
+    }
+    if (table.isFull || (*targetSteps >= 0 && (completed & targets) != targets))
+    {
+        *targetSteps = -1;
+        FreeSearchTable(&table);
+        FreeAligned(work);
+        return -1;
+    }
+
+    // Finish everyone else in any order that works
+    while (*targetSteps >= 0 && length < processCount)
+    {
+        for (processIndex = 0; processIndex < processCount; processIndex++)
+        {
+            if ((completed >> processIndex & 1) == 0
+                && FindShortfall(MatrixRow(needed, processIndex), work, rowStride) == rowStride) break;
+        }
+        if (processIndex == processCount) break;
+        AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+        completed |= 1ULL << processIndex;
+        sequence[length++] = processIndex;
+    }
+
+    FreeSearchTable(&table);
+    FreeAligned(work);
+    return length;
+}
+
+long long ListSafeSequences(struct SearchTable* table, unsigned long long completed, int* prefix, int length,
+                            int* work, long long limit)
+{
+    // Reports up to limit safe sequences that start with prefix (length processes, completed as a set),
+    // skipping every branch the counts say leads nowhere; returns how many were reported.
+    // Declare variables
+    int processIndex;
+    long long listed = 0;
+    unsigned long long runnable;
+
+    if (length == processCount)
+    {
+        ReportText("\n<");
+        for (processIndex = 0; processIndex < processCount; processIndex++)
+        {
+            ReportText(" p");
+            ReportInt(prefix[processIndex]);
+        }
+        ReportText(" >");
+        return 1;
+    }
+
+    runnable = RunnableSet(completed, work);
+    for (processIndex = 0; processIndex < processCount && listed < limit; processIndex++)
+    {
+        if ((runnable >> processIndex & 1) == 0) continue;
+        AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+        prefix[length] = processIndex;
+        if (CountSafeCompletions(table, completed | 1ULL << processIndex, processCount - length - 1, work) > 0)
+            listed += ListSafeSequences(table, completed | 1ULL << processIndex, prefix, length + 1, work, limit - listed);
+        SubtractRow(work, MatrixRow(allocated, processIndex), rowStride);
+    }
+
+    return listed;
+}
+
+void AnalyseSafeSequences(unsigned long long targets, long long listLimit)
+{
+    // Reports how many safe sequences there are, lists up to listLimit of them, and if targets is non-empty,
+    // the safe sequence that finishes the targets earliest.
+    // Declare variables
+    int processIndex;
+    int length;
+    int targetSteps;
+    unsigned long long count;
+    int* work;
+    int* sequence;
+    char text[64];
+    struct SearchTable table;
+
+    // Error Checking
+    if (processCount > SEARCH_PROCESS_LIMIT)
+    {
+        printf("\nERROR: The subset search handles at most %d processes!", SEARCH_PROCESS_LIMIT);
+        return;
+    }
+
+    // Count them
+    work = AllocateMatrix(1);
+    sequence = malloc(processCount * sizeof(int));
+    memcpy(work, available, rowStride * sizeof(int));
+    InitSearchTable(&table, 1024);
+    count = CountSafeCompletions(&table, 0, processCount, work);
+    if (table.isFull) ReportText("\nThe search grew too large to finish.");
+    else
+    {
+        snprintf(text, sizeof(text), "%s%llu (%lld completed sets visited)", count == ~0ULL ? "at least " : "",
+                 count, table.used);
+        ReportText("\nSafe sequences: ");
+        ReportText(text);
+    }
+
+    // List some of them
+    if (listLimit > 0 && count > 0 && !table.isFull) ListSafeSequences(&table, 0, sequence, 0, work, listLimit);
+    FreeSearchTable(&table);
+
+    // Find the earliest finish for the targets (a separate, far smaller search, so it's tried even if counting gave up)
+    if (targets != 0 && (count > 0 || table.isFull))
+    {
+        length = EarliestTargetSequence(targets, sequence, &targetSteps);
+        if (length < 0) ReportText("\nThe search for the targets grew too large to finish.");
+        else if (targetSteps < 0) ReportText("\nThe targets can't all finish safely.");
+        else
+        {
+            ReportText("\nEarliest sequence for the targets: <");
+            for (processIndex = 0; processIndex < length; processIndex++)
+            {
+                ReportText(" p");
+                ReportInt(sequence[processIndex]);
+            }
+            ReportText(" > (targets done after ");
+            ReportInt(targetSteps);
+            ReportText(" processes)");
+        }
+    }
+    ReportFlush();
+
+    free(sequence);
+    FreeAligned(work);
+}
+
+void TakeSequenceAnalysis()
+{
+    // Declare variables
+    int targetCount;
+    int targetIndex;
+    int processIndex;
+    long long listLimit;
+    unsigned long long targets = 0;
+
+    // Make sure there's a state to check
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    printf("Enter how many safe sequences to list (0 for none): ");
+    scanf("%lld", &listLimit);
+    printf("Enter number of target processes to finish earliest (0 for none): ");
+    scanf("%d", &targetCount);
+    for (targetIndex = 0; targetIndex < targetCount; targetIndex++)
+    {
+        printf("Enter target process: ");
+        scanf("%d", &processIndex);
+        if (processIndex >= 0 && processIndex < processCount && processIndex < SEARCH_PROCESS_LIMIT)
+            targets |= 1ULL << processIndex;
+    }
+    // Clear the input
+    fflush(stdin);
+
+    AnalyseSafeSequences(targets, listLimit);
+}
+
+/***************************************************************/
+int ScenarioSweep(const struct Scenario* scenario, int* work, int* pending, int* requesterNeed)
+{
+    // Runs the greedy sweep for one scenario without touching the shared state: work starts as the
+    // scenario's available vector, and the requesting process is checked against a private copy of its row.
+    // Returns whether everybody could be sequenced.
+    // Declare variables
+    int slot;
+    int keptCount;
+    int pendingCount = processCount;
+    int processIndex;
+    int fits;
+    int anyCompleted = 1;
+
+    for (slot = 0; slot < processCount; slot++)
+    {
+        pending[slot] = slot;
+    }
+    if (scenario->type == SCENARIO_REQUEST)
+    {
+        memcpy(requesterNeed, MatrixRow(needed, scenario->processIndex), rowStride * sizeof(int));
+        SubtractRow(requesterNeed, scenario->delta, resourceCount);
+    }
+
+    // Sweep until nobody else can be sequenced
+    while (anyCompleted && pendingCount > 0)
+    {
+        anyCompleted = 0;
+        keptCount = 0;
+        for (slot = 0; slot < pendingCount; slot++)
+        {
+            processIndex = pending[slot];
+            if (scenario->type == SCENARIO_REQUEST && processIndex == scenario->processIndex)
+            {
+                // The requester needs its request less, and also hands it back once it finishes
+                fits = FindShortfall(requesterNeed, work, rowStride) == rowStride;
+                if (fits) AddRow(work, scenario->delta, resourceCount);
+            }
+            else
+            {
+                fits = FindShortfall(MatrixRow(needed, processIndex), work, rowStride) == rowStride;
+            }
+
+            if (fits)
+            {
+                AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+                anyCompleted = 1;
+            }
+            else pending[keptCount++] = processIndex;
+        }
+        pendingCount = keptCount;
+    }
+
+    return pendingCount == 0;
+}
+
+int EvaluateScenario(const struct Scenario* scenario, int* work, int* pending, int* requesterNeed)
+{
+    // Judges one scenario against the shared state, returning a REQUEST_* code.
+    // Declare variables
+    int position;
+    int processIndex;
+    int isNonNegative;
+    int length = processCount;
+
+    // Build the scenario's starting available vector
+    memcpy(work, available, rowStride * sizeof(int));
+    if (scenario->type == SCENARIO_REQUEST)
+    {
+        // Error Checking
+        if (scenario->processIndex < 0 || scenario->processIndex >= processCount || !IsVectorInRange(scenario->delta))
+            return REQUEST_INVALID;
+        if (FindShortfall(scenario->delta, MatrixRow(needed, scenario->processIndex), resourceCount) < resourceCount)
+            return REQUEST_EXCEEDS_CLAIM;
+        if (FindShortfall(scenario->delta, available, resourceCount) < resourceCount)
+            return REQUEST_MUST_WAIT;
+
+        SubtractRow(work, scenario->delta, resourceCount);
+        // Only the processes ahead of the requester see a different state
+        if (safeSequenceValid) length = sequencePosition[scenario->processIndex];
+    }
+    else
+    {
+        AddRow(work, scenario->delta, resourceCount);
+        if (!IsVectorInRange(work)) return REQUEST_INVALID;
+        // More of everything can't make a safe state unsafe
+        isNonNegative = IsVectorInRange(scenario->delta);
+        if (safeSequenceValid && isNonNegative) return REQUEST_GRANTED;
+    }
+
+    // Re-walk the cached safe sequence if there is one
+    if (safeSequenceValid)
+    {
+        for (position = 0; position < length; position++)
+        {
+            processIndex = safeSequence[position];
+            if (FindShortfall(MatrixRow(needed, processIndex), work, rowStride) < rowStride) break;
+            AddRow(work, MatrixRow(allocated, processIndex), rowStride);
+        }
+        if (position == length) return REQUEST_GRANTED;
+
+        // Start over for the full sweep
+        memcpy(work, available, rowStride * sizeof(int));
+        if (scenario->type == SCENARIO_REQUEST) SubtractRow(work, scenario->delta, resourceCount);
+        else AddRow(work, scenario->delta, resourceCount);
+    }
+
+    return ScenarioSweep(scenario, work, pending, requesterNeed) ? REQUEST_GRANTED : REQUEST_UNSAFE;
+}
+
+void* ScenarioWorkerMain(void* argument)
+{
+    // Claims scenarios one at a time until the batch runs out, using private scratch space.
+    // Declare variables
+    struct ScenarioBatch* batch = argument;
+    int scenarioIndex;
+    int* work = AllocateMatrix(1);
+    int* requesterNeed = AllocateMatrix(1);
+    int* pending = malloc(processCount * sizeof(int));
+
+    while ((scenarioIndex = atomic_fetch_add(&batch->nextScenario, 1)) < batch->scenarioCount)
+    {
+        batch->verdicts[scenarioIndex] = EvaluateScenario(&batch->scenarios[scenarioIndex], work, pending, requesterNeed);
+    }
+
+    FreeAligned(work);
+    FreeAligned(requesterNeed);
+    free(pending);
+    return NULL;
+}
+
+void EvaluateScenarios(const struct Scenario* scenarios, int scenarioCount, int* verdicts)
+{
+    // Judges every scenario against the current state in parallel, writing one REQUEST_* code each.
+    // The matrices are shared read-only; each thread only owns an available vector and a pending list.
+    // Declare variables
+    int threadIndex;
+    int threadCount;
+    struct ScenarioBatch batch;
+    pthread_t* threads;
+
+    // Find the base state's safe sequence so most scenarios only need a partial re-walk
+    if (!safeSequenceValid && EventDrivenSafeSequence(needed, available, candidateSequence) == processCount)
+    {
+        AdoptSafeSequence(candidateSequence);
+    }
+
+    // Decide how many threads to use
+    threadCount = workerCount > 0 ? workerCount : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount > scenarioCount) threadCount = scenarioCount;
+    if (threadCount < 1) threadCount = 1;
+
+    // Let every thread (this one included) claim scenarios
+    batch.scenarios = scenarios;
+    batch.scenarioCount = scenarioCount;
+    batch.verdicts = verdicts;
+    atomic_init(&batch.nextScenario, 0);
+    threads = malloc(threadCount * sizeof(pthread_t));
+    for (threadIndex = 1; threadIndex < threadCount; threadIndex++)
+    {
+        pthread_create(&threads[threadIndex], NULL, ScenarioWorkerMain, &batch);
+    }
+    ScenarioWorkerMain(&batch);
+    for (threadIndex = 1; threadIndex < threadCount; threadIndex++)
+    {
+        pthread_join(threads[threadIndex], NULL);
+    }
+
+    free(threads);
+}
+
+void TakeScenarios()
+{
+    // Declare variables
+    int scenarioCount;
+    int scenarioIndex;
+    int resourceIndex;
+    int isInputBad;
+    int* deltas;
+    int* verdicts;
+    struct Scenario* scenarios;
+
+    // Make sure there's a state to check
+    if (needed == NULL)
+    {
+        printf("\nERROR: Parameters must be entered first!");
+        return;
+    }
+
+    // Take the number of scenarios
+    do
+    {
+        isInputBad = 0;
+
+        printf("Enter number of scenarios: ");
+        scanf("%d", &scenarioCount);
+
+        // Error Checking
+        if (scenarioCount <= 0)
+        {
+            // Print the error
+            printf("ERROR: Number of scenarios must be at least 1!\n");
+            // Restart this question
+            isInputBad = 1;
+        }
+        // Clear the input
+        fflush(stdin);
+    } while (isInputBad);
+
+    // Instantiate the scenarios, with every delta in one block
+    scenarios = malloc(scenarioCount * sizeof(struct Scenario));
+    deltas = malloc((size_t) scenarioCount * resourceCount * sizeof(int));
+    verdicts = malloc(scenarioCount * sizeof(int));
+
+    // Take each scenario
+    for (scenarioIndex = 0; scenarioIndex < scenarioCount; scenarioIndex++)
+    {
+        printf("Enter scenario %d as type (0=request, 1=available change), process (ignored for 1), "
+               "then units of each resource (r0 to r%d): ", scenarioIndex, resourceCount - 1);
+        scanf("%d %d", &scenarios[scenarioIndex].type, &scenarios[scenarioIndex].processIndex);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            scanf("%d", &deltas[(size_t) scenarioIndex * resourceCount + resourceIndex]);
+        }
+        scenarios[scenarioIndex].type = scenarios[scenarioIndex].type == SCENARIO_AVAILABLE
+                                        ? SCENARIO_AVAILABLE : SCENARIO_REQUEST;
+        scenarios[scenarioIndex].delta = deltas + (size_t) scenarioIndex * resourceCount;
+        // Clear the input
+        fflush(stdin);
+    }
+
+    // Evaluate and report
+    EvaluateScenarios(scenarios, scenarioCount, verdicts);
+    printf("\nScenario\tVerdict\n------------------------");
+    for (scenarioIndex = 0; scenarioIndex < scenarioCount; scenarioIndex++)
+    {
+        printf("\n%d\t\t%s", scenarioIndex,
+               verdicts[scenarioIndex] == REQUEST_GRANTED ? "safe" : requestMessages[verdicts[scenarioIndex]]);
+    }
+
+    free(scenarios);
+    free(deltas);
+    free(verdicts);
+}
+
+void TakeSolverMode()
+{
+    // Declare variables
+    int isInputBad;
+
+    // Take the solver choice
+    do
+    {
+        isInputBad = 0;
+
+        printf("Enter solver (0=greedy sweep, 1=event-driven, 2=parallel sweep, 3=sparse event-driven, "
+               "4=fixed-width sweep for up to 16 resources): ");
+        scanf("%d", &solverMode);
+
+        // Error Checking
+        if (solverMode < SOLVER_GREEDY || solverMode > SOLVER_LAST)
+        {
+            // Print the error
+            printf("ERROR: Solver choice must be from 0 to %d!\n", SOLVER_LAST);
+            // Restart this question
+            isInputBad = 1;
+        }
+        // Clear the input
+        fflush(stdin);
+    } while (isInputBad);
+
+    // Take the thread count for the parallel solver
+    while (solverMode == SOLVER_PARALLEL)
+    {
+        printf("Enter number of worker threads (0=one per core): ");
+        scanf("%d", &workerCount);
+
+        // Error Checking
+        if (workerCount >= 0) break;
+        printf("ERROR: Number of worker threads must not be negative!\n");
+        // Clear the input
+        fflush(stdin);
+    }
+}
+
+void TakeVerbosity()
+{
+    // Declare variables
+    int isInputBad;
+
+    // Take the verbosity choice
+    do
+    {
+        isInputBad = 0;
+
+        printf("Enter report verbosity (0=silent, 1=summary, 2=trace every check): ");
+        scanf("%d", &reportVerbosity);
+
+        // Error Checking
+        if (reportVerbosity < REPORT_SILENT || reportVerbosity > REPORT_TRACE)
+        {
+            // Print the error
+            printf("ERROR: Verbosity must be from 0 to 2!\n");
+            // Restart this question
+            isInputBad = 1;
+        }
+        // Clear the input
+        fflush(stdin);
+    } while (isInputBad);
+}
+
+/***************************************************************/
+void GenerateState(int processes, int resourceTypes, double density, int kind, unsigned int seed)
+{
+    // Builds a random state of the given kind (one of STATE_*) where roughly density of the
+    // (process, resource) pairs hold or need anything. Processes are visited in a completion order and
+    // each one is given needs no larger than what would be available once everyone before it has finished.
+    // Declare variables
+    int processIndex;
+    int resourceIndex;
+    int swapIndex;
+    int swap;
+    int* order;
+    int* row;
+    unsigned int threshold = (unsigned int) (density * 4294967295.0);
+
+    // Size the state
+    processCount = processes;
+    resourceCount = resourceTypes;
+    AllocateState();
+    if (seed == 0) seed = 1;
+
+    // Give every resource plenty of units, and hand some of them out
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        resources[resourceIndex] = processCount * 4 + (int) (NextRandom(&seed) % 16);
+        available[resourceIndex] = resources[resourceIndex];
+    }
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = MatrixRow(allocated, processIndex);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            row[resourceIndex] = NextRandom(&seed) <= threshold ? 1 + (int) (NextRandom(&seed) % 3) : 0;
+        }
+        // The adversarial chain runs through resource 0, so everybody must hold some of it
+        if (kind == STATE_ADVERSARIAL && row[0] == 0) row[0] = 1;
+        SubtractRow(available, row, resourceCount);
+    }
+
+    // Pick the completion order: shuffled, or last-to-first so every greedy sweep finishes just one process
+    order = malloc(processCount * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        order[processIndex] = kind == STATE_ADVERSARIAL ? processCount - 1 - processIndex : processIndex;
+    }
+    for (processIndex = processCount - 1; processIndex > 0 && kind != STATE_ADVERSARIAL; processIndex--)
+    {
+        swapIndex = (int) (NextRandom(&seed) % (unsigned int) (processIndex + 1));
+        swap = order[processIndex];
+        order[processIndex] = order[swapIndex];
+        order[swapIndex] = swap;
+    }
+
+    // Walk the order, keeping every need within reach (requestWork tracks what would be available)
+    memcpy(requestWork, available, rowStride * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        row = MatrixRow(needed, order[processIndex]);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            row[resourceIndex] = NextRandom(&seed) <= threshold
+                                 ? (int) (NextRandom(&seed) % (unsigned int) (requestWork[resourceIndex] + 1)) : 0;
+        }
+        // Needing exactly what's available keeps each process blocked until its predecessor finishes
+        if (kind == STATE_ADVERSARIAL) row[0] = requestWork[0];
+        AddRow(requestWork, MatrixRow(allocated, order[processIndex]), rowStride);
+    }
+
+    // Make one process want more than exists, so it can never finish
+    if (kind == STATE_UNSAFE)
+    {
+        processIndex = (int) (NextRandom(&seed) % (unsigned int) processCount);
+        resourceIndex = (int) (NextRandom(&seed) % (unsigned int) resourceCount);
+        MatrixRow(needed, processIndex)[resourceIndex] = resources[resourceIndex] + 1;
+    }
+
+    // Derive the max claims
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        memcpy(MatrixRow(maxClaim, processIndex), MatrixRow(needed, processIndex), rowStride * sizeof(int));
+        AddRow(MatrixRow(maxClaim, processIndex), MatrixRow(allocated, processIndex), rowStride);
+    }
+
+    free(order);
+}
+
+void RunScalingBenchmark(int processes, int resourceTypes, int maxThreads)
+{
+    // Times the parallel solver on one generated state with 1..maxThreads threads.
+    // Declare variables
+    int threads;
+    int repeat;
+    int sequenced;
+    int* sequence;
+    double start;
+    double best;
+    double elapsed;
+    double single = 0;
+
+    // Build the state
+    printf("Generating %d processes x %d resources...\n", processes, resourceTypes);
+    GenerateState(processes, resourceTypes, 1.0, STATE_SAFE, 12345);
+    sequence = malloc(processCount * sizeof(int));
+    if (maxThreads <= 0) maxThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    // Time each thread count, keeping the best of a few runs
+    printf("\nThreads\tms/solve\tSpeedup\tVerdict\n---------------------------------------\n");
+    for (threads = 1; threads <= maxThreads; threads++)
+    {
+        workerCount = threads;
+        best = -1;
+        for (repeat = 0; repeat < 3; repeat++)
+        {
+            start = NowSeconds();
+            sequenced = ParallelSafeSequence(needed, available, sequence);
+            elapsed = NowSeconds() - start;
+            if (best < 0 || elapsed < best) best = elapsed;
+        }
+        if (threads == 1) single = best;
+
+        printf("%d\t%.3f\t\t%.2fx\t%s\n", threads, best * 1000, single / best,
+               sequenced == processCount ? "safe" : "deadlock");
+    }
+
+    free(sequence);
+    FreeState();
+}
+
+void RunBenchmarkSuite(int processes, int resourceTypes, double density, int repeats)
+{
+    // Times every solver mode on a safe, an unsafe and an adversarial generated state.
+    // Declare variables
+    int kind;
+    int mode;
+    int repeat;
+    int sequenced = 0;
+    int* sequence;
+    int savedVerbosity = reportVerbosity;
+    long long checks;
+    double start;
+    double elapsed;
+    struct SparseState sparseCopy;
+
+    // Keep the solvers quiet and untimed while timing them
+    reportVerbosity = REPORT_SILENT;
+    solverTiming = 0;
+    if (repeats < 1) repeats = 1;
+    printf("%d processes x %d resources, density %.3f, %d run(s) each (sparse times exclude compression)\n",
+           processes, resourceTypes, density, repeats);
+    printf("\nState\t\tSolver\t\tms/solve\tChecks/solve\tChecks/sec\tVerdict\n"
+           "--------------------------------------------------------------------------------------------\n");
+
+    for (kind = STATE_SAFE; kind <= STATE_ADVERSARIAL; kind++)
+    {
+        // Build the state, and a sparse copy of it for the sparse solver
+        GenerateState(processes, resourceTypes, density, kind, 12345 + kind);
+        CompressState(&sparseCopy);
+        sequence = malloc(processCount * sizeof(int));
+
+        for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++)
+        {
+            // Run the solver a few times, counting its checks
+            solverStats.processChecks = 0;
+            start = NowSeconds();
+            for (repeat = 0; repeat < repeats; repeat++)
             {
-                // Write the needed and available resources to their respective strings through the buffer.
-                sprintf(buffer, " %d", needed[processIndex][resourceIndex]);
-                strcat(printStringA, buffer);
-                sprintf(buffer, " %d", availableLocal[resourceIndex]);
-                strcat(printStringB, buffer);
+                if (mode == SOLVER_SPARSE) sequenced = SparseSafeSequence(&sparseCopy, sequence);
+                else sequenced = SolveSafeSequence(mode, sequence);
             }
+            elapsed = (NowSeconds() - start) / repeats;
+            checks = solverStats.processChecks / repeats;
 
-            // Branch if we can sequence
-            if (canSequence)
+            printf("%-12s\t%-12s\t%.3f\t\t%lld\t\t%.3g\t\t%s\n", stateKindNames[kind], solverNames[mode],
+                   elapsed * 1000, checks, elapsed > 0 ? checks / elapsed : 0.0,
+                   sequenced == processCount ? "safe" : "deadlock");
+        }
+
+        free(sequence);
+        FreeSparseState(&sparseCopy);
+    }
+
+    FreeState();
+    reportVerbosity = savedVerbosity;
+    solverTiming = 1;
+}
+
+int RunSolverSelfTest(int states)
+{
+    // Runs every solver on generated states of each kind and checks that they reach the same verdict, that
+    // the greedy and fixed-width sweeps (which visit processes in the same order) agree on the sequence and the
+    // passes, that the event-driven ones make one scan, and that the parallel one (whose sweeps only see the
+    // releases of earlier sweeps) never needs fewer passes. Returns how many states disagreed.
+    // Declare variables
+    int stateIndex;
+    int mode;
+    int mismatches = 0;
+    int sequenced[SOLVER_LAST + 1];
+    long long passes[SOLVER_LAST + 1];
+    int* sequences[SOLVER_LAST + 1];
+    int* maxRow;
+
+    reportVerbosity = REPORT_SILENT;
+    for (stateIndex = 0; stateIndex < states; stateIndex++)
+    {
+        // Vary the size, kind and resource count, so both the fixed-width kernels and its fallback are run
+        GenerateState(8 + stateIndex % 57, 1 + stateIndex % 20, stateIndex % 4 == 0 ? 0.3 : 1.0, stateIndex % 3,
+                      777 + stateIndex);
+        if (stateIndex % 5 == 4)
+        {
+            // Take r0 to the edge of the 16-bit lanes, with the last process still needing all of it or one more
+            available[0] += 32766 + stateIndex / 20 % 2 - resources[0];
+            resources[0] = 32766 + stateIndex / 20 % 2;
+            maxRow = AllocateMatrix(1);
+            memcpy(maxRow, MatrixRow(maxClaim, processCount - 1), rowStride * sizeof(int));
+            maxRow[0] = MatrixRow(allocated, processCount - 1)[0] + resources[0] + stateIndex / 40 % 2;
+            SetProcessMax(processCount - 1, maxRow);
+            FreeAligned(maxRow);
+        }
+        for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++)
+        {
+            memset(&solverStats, 0, sizeof(solverStats));
+            sequences[mode] = malloc(processCount * sizeof(int));
+            sequenced[mode] = SolveSafeSequence(mode, sequences[mode]);
+            passes[mode] = solverStats.passes;
+        }
+
+        // Compare them against the greedy solver
+        for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++)
+        {
+            if ((sequenced[mode] == processCount) != (sequenced[SOLVER_GREEDY] == processCount)) break;
+        }
+        if (mode <= SOLVER_LAST || sequenced[SOLVER_FIXED_WIDTH] != sequenced[SOLVER_GREEDY]
+            || memcmp(sequences[SOLVER_FIXED_WIDTH], sequences[SOLVER_GREEDY], sequenced[SOLVER_GREEDY] * sizeof(int)) != 0
+            || passes[SOLVER_FIXED_WIDTH] != passes[SOLVER_GREEDY] || passes[SOLVER_PARALLEL] < passes[SOLVER_GREEDY]
+            || passes[SOLVER_EVENT_DRIVEN] != 1 || passes[SOLVER_SPARSE] != 1)
+        {
+            printf("MISMATCH: state %d (%d processes x %d resources, %s), passes", stateIndex, processCount,
+                   resourceCount, stateKindNames[stateIndex % 3]);
+            for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++)
             {
-                // Flag that we've completed a process this cycle
-                anyCompleted = 1;
-                // Flag that this process is complete
-                completed[processIndex] = 1;
-                // Free the resources that were previously allocated
-                for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
-                {
-                    availableLocal[resourceIndex] += allocated[processIndex][resourceIndex];
-                }
+                printf(" %s=%lld", solverNames[mode], passes[mode]);
+            }
+            printf("\n");
+            mismatches++;
+        }
+        for (mode = SOLVER_GREEDY; mode <= SOLVER_LAST; mode++) free(sequences[mode]);
+    }
+    printf("%d state(s) checked, %d mismatch(es)\n", states, mismatches);
+
+    FreeState();
+    memset(&solverStats, 0, sizeof(solverStats));
+    return mismatches;
+}
+
+int CompareDouble(const void* left, const void* right)
+{
+    // Declare variables
+    double leftValue = *(const double*) left;
+    double rightValue = *(const double*) right;
+
+    return (leftValue > rightValue) - (leftValue < rightValue);
+}
+
+void* StressWorkerMain(void* argument)
+{
+    // Randomly requests and releases resources for this thread's processes through the manager.
+    // Only this thread changes its processes' rows, so it may read them without the lock.
+    // Declare variables
+    struct StressWorker* worker = argument;
+    int operation;
+    int processIndex;
+    int resourceIndex;
+    int limit;
+    int result;
+    int isRelease;
+    int ownedCount = (processCount - worker->threadIndex + worker->threadCount - 1) / worker->threadCount;
+    int* vector = AllocateMatrix(1);
+    int* view = AllocateMatrix(1);
+    const int* need;
+    const int* held;
+    unsigned int seed = 2654435761u * (unsigned int) (worker->threadIndex + 1);
+    double start;
+
+    for (operation = 0; operation < worker->operations; operation++)
+    {
+        // Pick one of our processes, and whether it gives back or asks for more
+        processIndex = worker->threadIndex + worker->threadCount * (int) (NextRandom(&seed) % (unsigned int) ownedCount);
+        need = MatrixRow(needed, processIndex);
+        held = MatrixRow(allocated, processIndex);
+        isRelease = IsRowEmpty(need) || (!IsRowEmpty(held) && NextRandom(&seed) % 2 == 0);
+
+        // Size the vector from what's held, or from what the snapshot says is available
+        if (!isRelease) worker->snapshotRetries += ReadAvailableSnapshot(view);
+        for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+        {
+            limit = isRelease ? held[resourceIndex]
+                              : need[resourceIndex] < view[resourceIndex] ? need[resourceIndex] : view[resourceIndex];
+            vector[resourceIndex] = limit > 0 ? (int) (NextRandom(&seed) % (unsigned int) (limit / 2 + 1)) : 0;
+        }
+
+        // Time the decision alone
+        start = NowSeconds();
+        result = isRelease ? ManagerRelease(processIndex, vector) : ManagerRequest(processIndex, vector);
+        worker->latencies[operation] = NowSeconds() - start;
+        worker->outcomes[result]++;
+    }
+
+    FreeAligned(vector);
+    FreeAligned(view);
+    return NULL;
+}
+
+void RunStressBenchmark(int threadCount, int operations, int processes, int resourceTypes)
+{
+    // Hammers the resource manager from several threads, then reports throughput, latency and whether the
+    // final state still adds up and is safe.
+    // Declare variables
+    int threadIndex;
+    int processIndex;
+    int resourceIndex;
+    int result;
+    int isConsistent = 1;
+    long long total;
+    long long retries = 0;
+    long long outcomes[REQUEST_LAST + 1] = { 0 };
+    int* sequence;
+    int* held;
+    double* latencies;
+    double start;
+    double elapsed;
+    struct StressWorker* workers;
+
+    // Build the state, giving every thread at least one process
+    if (processes < 1) processes = 1;
+    if (resourceTypes < 1) resourceTypes = 1;
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > processes) threadCount = processes;
+    if (operations < 1) operations = 1;
+    GenerateState(processes, resourceTypes, 1.0, STATE_SAFE, 12345);
+    OpenResourceManager();
+    printf("%d thread(s) x %d operations over %d processes x %d resources\n",
+           threadCount, operations, processCount, resourceCount);
+
+    // Run every worker at once
+    workers = calloc(threadCount, sizeof(struct StressWorker));
+    latencies = malloc((size_t) threadCount * operations * sizeof(double));
+    start = NowSeconds();
+    for (threadIndex = 0; threadIndex < threadCount; threadIndex++)
+    {
+        workers[threadIndex].threadIndex = threadIndex;
+        workers[threadIndex].threadCount = threadCount;
+        workers[threadIndex].operations = operations;
+        workers[threadIndex].latencies = latencies + (size_t) threadIndex * operations;
+        pthread_create(&workers[threadIndex].thread, NULL, StressWorkerMain, &workers[threadIndex]);
+    }
+    for (threadIndex = 0; threadIndex < threadCount; threadIndex++)
+    {
+        pthread_join(workers[threadIndex].thread, NULL);
+        for (result = 0; result <= REQUEST_LAST; result++) outcomes[result] += workers[threadIndex].outcomes[result];
+        retries += workers[threadIndex].snapshotRetries;
+    }
+    elapsed = NowSeconds() - start;
+    CloseResourceManager();
+
+    // Sort the latencies for the percentiles
+    total = (long long) threadCount * operations;
+    qsort(latencies, (size_t) total, sizeof(double), CompareDouble);
+    printf("\nThroughput: %.0f decisions/sec (%.3f s)\n", total / elapsed, elapsed);
+    printf("Latency (us): p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", latencies[total / 2] * 1e6,
+           latencies[total * 99 / 100] * 1e6, latencies[total * 999 / 1000] * 1e6, latencies[total - 1] * 1e6);
+    for (result = 0; result <= REQUEST_LAST; result++)
+    {
+        printf("%-10lld %s\n", outcomes[result], requestMessages[result]);
+    }
+    printf("Snapshot retries: %lld\n", retries);
+
+    // Check nothing was lost: available plus everything allocated must still be every resource
+    held = AllocateMatrix(1);
+    memcpy(held, available, rowStride * sizeof(int));
+    for (processIndex = 0; processIndex < processCount; processIndex++)
+    {
+        AddRow(held, MatrixRow(allocated, processIndex), rowStride);
+    }
+    for (resourceIndex = 0; resourceIndex < resourceCount; resourceIndex++)
+    {
+        if (held[resourceIndex] != resources[resourceIndex]) isConsistent = 0;
+    }
+    sequence = malloc(processCount * sizeof(int));
+    printf("Final state: %s, %s\n", isConsistent ? "consistent" : "INCONSISTENT",
+           SolveSafeSequence(SOLVER_EVENT_DRIVEN, sequence) == processCount ? "safe" : "UNSAFE");
+
+    free(sequence);
+    FreeAligned(held);
+    free(latencies);
+    free(workers);
+    FreeState();
+}
+
+/***************************************************************/
+void StopDaemon(int signalNumber)
+{
+    (void) signalNumber;
+    daemonStopping = 1;
+}
+
+void SettleDaemonBatch(struct DaemonBatch* batch)
+{
+    // Judges every unsettled request in the batch with one safety evaluation and journals the granted ones.
+    // If they're unsafe together, they're rolled back and every request is decided again one at a time in
+    // arrival order, including those that only had to wait because of grants that were just rolled back.
+    // Declare variables
+    int entry;
+    int tentative = 0;
+    int prefixLength = 0;
+
+    // Only processes up to the last requester in the safe sequence can see a difference
+    for (entry = batch->settled; entry < batch->count; entry++)
+    {
+        if (batch->operations[entry] != DAEMON_OP_REQUEST || batch->results[entry] != REQUEST_GRANTED) continue;
+        tentative++;
+        if (safeSequenceValid && sequencePosition[batch->processes[entry]] > prefixLength)
+            prefixLength = sequencePosition[batch->processes[entry]];
+    }
+
+    if (tentative > 0 && !IsGrantedStateSafe(prefixLength))
+    {
+        // Undo the whole batch; a lone grant was judged against exactly the state it arrived to, so it stands as unsafe
+        for (entry = batch->settled; entry < batch->count; entry++)
+        {
+            if (batch->results[entry] != REQUEST_GRANTED) continue;
+            ReturnResources(batch->processes[entry], MatrixRow(batch->vectors, entry));
+            if (tentative == 1) batch->results[entry] = REQUEST_UNSAFE;
+        }
+        // Replay everything else one request at a time (only an invalid request can't change its verdict)
+        for (entry = batch->settled; entry < batch->count; entry++)
+        {
+            if (batch->results[entry] != REQUEST_INVALID && batch->results[entry] != REQUEST_UNSAFE)
+                batch->results[entry] = RequestResources(batch->processes[entry], MatrixRow(batch->vectors, entry));
+        }
+        if (tentative > 1) batch->fallbackCount++;
+    }
+    else if (tentative > 0) detectionValid = 0;
+
+    // Journal what was granted
+    for (entry = batch->settled; entry < batch->count; entry++)
+    {
+        if (batch->operations[entry] == DAEMON_OP_REQUEST && batch->results[entry] == REQUEST_GRANTED)
+            JournalAppend(JOURNAL_REQUEST, batch->processes[entry], MatrixRow(batch->vectors, entry));
+    }
+    if (tentative > 0)
+    {
+        batch->batchCount++;
+        batch->requestCount += batch->count - batch->settled;
+    }
+    batch->settled = batch->count;
+}
+
+void AnswerDaemonBatch(struct DaemonBatch* batch, struct DaemonClient* clients)
+{
+    // Settles the batch, commits its journal records with one sync, then answers every message in it.
+    // Declare variables
+    int entry;
+
+    SettleDaemonBatch(batch);
+
+    // Undo the whole batch, newest first, if its records didn't reach the disk
+    if (!JournalCommit())
+    {
+        for (entry = batch->count - 1; entry >= 0; entry--)
+        {
+            if (batch->results[entry] != REQUEST_GRANTED) continue;
+            if (batch->operations[entry] == DAEMON_OP_REQUEST) ReturnResources(batch->processes[entry], MatrixRow(batch->vectors, entry));
+            else GrantResources(batch->processes[entry], MatrixRow(batch->vectors, entry));
+            batch->results[entry] = REQUEST_NOT_SAVED;
+        }
+        safeSequenceValid = 0;
+        detectionValid = 0;
+    }
+    for (entry = 0; entry < batch->count; entry++)
+    {
+        if (clients[batch->clients[entry]].socket >= 0)
+            WriteAll(clients[batch->clients[entry]].socket, &batch->results[entry], sizeof(int));
+    }
+    batch->count = 0;
+    batch->settled = 0;
+}
+
+int HandleDaemonMessages(int clientIndex, struct DaemonClient* clients, struct DaemonBatch* batch)
+{
+    // Handles every complete message a connection has sent: requests and releases join the batch,
+    // descriptions are answered at once. Returns 0 (after replying REQUEST_INVALID) if the connection broke the protocol.
+    // Declare variables
+    int reply[3];
+    int entry;
+    size_t size;
+    size_t offset = 0;
+    struct DaemonHeader header;
+    struct DaemonClient* client = &clients[clientIndex];
+
+    while (client->filled - offset >= sizeof(header))
+    {
+        // Wait for the rest of the message
+        memcpy(&header, client->buffer + offset, sizeof(header));
+        if (header.operation < DAEMON_OP_REQUEST || header.operation > DAEMON_OP_DESCRIBE
+            || header.count != (header.operation == DAEMON_OP_DESCRIBE ? 0 : resourceCount))
+        {
+            reply[0] = REQUEST_INVALID;
+            WriteAll(client->socket, reply, sizeof(int));
+            return 0;
+        }
+        size = sizeof(header) + (size_t) header.count * sizeof(int);
+        if (client->filled - offset < size) break;
+
+        if (header.operation == DAEMON_OP_DESCRIBE)
+        {
+            reply[0] = REQUEST_GRANTED;
+            reply[1] = processCount;
+            reply[2] = resourceCount;
+            WriteAll(client->socket, reply, sizeof(reply));
+            offset += size;
+            continue;
+        }
+
+        // Queue the message, settling the requests before a release first so a rollback never undoes a grant it depends on
+        if (batch->count == DAEMON_BATCH_LIMIT) AnswerDaemonBatch(batch, clients);
+        if (header.operation == DAEMON_OP_RELEASE) SettleDaemonBatch(batch);
+        entry = batch->count++;
+        memcpy(MatrixRow(batch->vectors, entry), client->buffer + offset + sizeof(header), resourceCount * sizeof(int));
+        batch->clients[entry] = clientIndex;
+        batch->operations[entry] = header.operation;
+        batch->processes[entry] = header.processIndex;
+        if (header.operation == DAEMON_OP_RELEASE)
+        {
+            batch->results[entry] = ReleaseResources(header.processIndex, MatrixRow(batch->vectors, entry));
+            if (batch->results[entry] == REQUEST_GRANTED)
+                JournalAppend(JOURNAL_RELEASE, header.processIndex, MatrixRow(batch->vectors, entry));
+            batch->settled = batch->count;
+        }
+        else
+        {
+            // Tentatively grant the request if nothing but safety stands in its way
+            batch->results[entry] = CheckRequest(header.processIndex, MatrixRow(batch->vectors, entry));
+            if (batch->results[entry] == REQUEST_GRANTED) GrantResources(header.processIndex, MatrixRow(batch->vectors, entry));
+        }
+        offset += size;
+    }
+
+    // Keep the partial message for next time
+    memmove(client->buffer, client->buffer + offset, client->filled - offset);
+    client->filled -= (int) offset;
+    return 1;
+}
+
+void RunDaemon(const char* path, const char* stateFile)
+{
+    // Serves requests and releases over a Unix socket until SIGINT or SIGTERM, batching the requests that
+    // arrive in each poll round into one safety evaluation.
+    // Declare variables
+    int listener;
+    int accepted;
+    int clientIndex;
+    int clientCount = 0;
+    int liveCount;
+    ssize_t got;
+    size_t bufferSize;
+    struct sockaddr_un address;
+    struct pollfd* polled;
+    struct DaemonClient* clients;
+    struct DaemonBatch batch;
+
+    // Carry on from the recovered state, or load or generate one
+    if (needed == NULL)
+    {
+        if (stateFile != NULL && !LoadStateFile(stateFile)) return;
+        if (stateFile == NULL) GenerateState(256, 8, 1.0, STATE_SAFE, 12345);
+        CheckpointState();
+    }
+
+    // Listen on the socket
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        printf("ERROR: Could not listen on %s!\n", path);
+        if (listener >= 0) close(listener);
+        FreeState();
+        return;
+    }
+    signal(SIGINT, StopDaemon);
+    signal(SIGTERM, StopDaemon);
+    signal(SIGPIPE, SIG_IGN);
+    printf("Serving %d processes x %d resources on %s\n", processCount, resourceCount, path);
+    fflush(stdout);
 
-                printf("\nChecking: <%s > <= <%s > :p%d safely sequenced", printStringA, printStringB, processIndex);
+    // Instantiate the connection table and the batch, giving each connection room for several whole messages
+    bufferSize = 4 * (sizeof(struct DaemonHeader) + resourceCount * sizeof(int));
+    if (bufferSize < DAEMON_BUFFER_SIZE) bufferSize = DAEMON_BUFFER_SIZE;
+    polled = malloc((DAEMON_CLIENT_LIMIT + 1) * sizeof(struct pollfd));
+    clients = malloc(DAEMON_CLIENT_LIMIT * sizeof(struct DaemonClient));
+    memset(&batch, 0, sizeof(batch));
+    batch.vectors = AllocateMatrix(DAEMON_BATCH_LIMIT);
+
+    while (!daemonStopping)
+    {
+        // Wait for a connection or a message
+        polled[0].fd = listener;
+        polled[0].events = POLLIN;
+        for (clientIndex = 0; clientIndex < clientCount; clientIndex++)
+        {
+            polled[clientIndex + 1].fd = clients[clientIndex].socket;
+            polled[clientIndex + 1].events = POLLIN;
+        }
+        if (poll(polled, clientCount + 1, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // Read whatever every connection sent, so this round's requests from all of them share a batch
+        for (clientIndex = 0; clientIndex < clientCount; clientIndex++)
+        {
+            if ((polled[clientIndex + 1].revents & (POLLIN | POLLHUP | POLLERR)) == 0) continue;
+            got = read(clients[clientIndex].socket, clients[clientIndex].buffer + clients[clientIndex].filled,
+                       bufferSize - clients[clientIndex].filled);
+            if (got <= 0 && !(got < 0 && errno == EINTR))
+            {
+                close(clients[clientIndex].socket);
+                clients[clientIndex].socket = -1;
+            }
+            else if (got > 0) clients[clientIndex].filled += (int) got;
+        }
+        for (clientIndex = 0; clientIndex < clientCount; clientIndex++)
+        {
+            if (clients[clientIndex].socket >= 0 && !HandleDaemonMessages(clientIndex, clients, &batch))
+            {
+                close(clients[clientIndex].socket);
+                clients[clientIndex].socket = -1;
             }
+        }
+        AnswerDaemonBatch(&batch, clients);
+
+        // Drop closed connections, then take on a new one
+        liveCount = 0;
+        for (clientIndex = 0; clientIndex < clientCount; clientIndex++)
+        {
+            if (clients[clientIndex].socket >= 0) clients[liveCount++] = clients[clientIndex];
+            else free(clients[clientIndex].buffer);
+        }
+        clientCount = liveCount;
+        if ((polled[0].revents & POLLIN) != 0 && (accepted = accept(listener, NULL, NULL)) >= 0)
+        {
+            if (clientCount == DAEMON_CLIENT_LIMIT) close(accepted);
             else
             {
-                // Print that we've sequenced unsuccessfully
-                printf("\nChecking: <%s > <= <%s > :p%d could not be sequenced", printStringA, printStringB, processIndex);
+                clients[clientCount].socket = accepted;
+                clients[clientCount].filled = 0;
+                clients[clientCount].buffer = malloc(bufferSize);
+                clientCount++;
             }
         }
+    }
+
+    // Shut down
+    printf("\n%lld requests in %lld batches (%.2f per batch), %lld batch(es) decided one by one\n",
+           batch.requestCount, batch.batchCount, batch.batchCount > 0 ? (double) batch.requestCount / batch.batchCount : 0.0,
+           batch.fallbackCount);
+    if (persistence.isOpen) printf("%lld journal sync(s)\n", persistence.commitCount);
+    for (clientIndex = 0; clientIndex < clientCount; clientIndex++)
+    {
+        close(clients[clientIndex].socket);
+        free(clients[clientIndex].buffer);
+    }
+    close(listener);
+    unlink(path);
+    free(polled);
+    free(clients);
+    FreeAligned(batch.vectors);
+    ClosePersistence();
+    FreeState();
+}
+
+int ConnectDaemon(const char* path)
+{
+    // Opens a connection to the daemon; returns the socket, or -1 on failure.
+    // Declare variables
+    int connection;
+    struct sockaddr_un address;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection >= 0 && connect(connection, (struct sockaddr*) &address, sizeof(address)) != 0)
+    {
+        close(connection);
+        connection = -1;
+    }
+
+    return connection;
+}
+
+int DaemonRoundTrip(int connection, int operation, int processIndex, const int* values, int count, int* message)
+{
+    // Sends one request or release (count values) and waits for its status; returns it, or -1 if the connection broke.
+    // message is scratch space for the header and values.
+    // Declare variables
+    int status;
+    struct DaemonHeader header;
+
+    header.operation = operation;
+    header.processIndex = processIndex;
+    header.count = count;
+    memcpy(message, &header, sizeof(header));
+    memcpy((char*) message + sizeof(header), values, count * sizeof(int));
+    if (!WriteAll(connection, message, sizeof(header) + count * sizeof(int)) || !ReadAll(connection, &status, sizeof(status)))
+        return -1;
+
+    return status;
+}
+
+void* DaemonLoadWorkerMain(void* argument)
+{
+    // Requests small amounts for this connection's processes and releases what they were granted,
+    // one round trip at a time, then hands everything back.
+    // Declare variables
+    struct DaemonLoadWorker* worker = argument;
+    int operation;
+    int ownedIndex;
+    int processIndex;
+    int resourceIndex;
+    int result;
+    int isRelease;
+    int connection = ConnectDaemon(worker->path);
+    int ownedCount = (worker->processCount - worker->connectionIndex + worker->connectionCount - 1) / worker->connectionCount;
+    int* held = calloc((size_t) ownedCount * worker->resourceCount, sizeof(int));
+    int* vector = malloc(worker->resourceCount * sizeof(int));
+    int* message = malloc(sizeof(struct DaemonHeader) + worker->resourceCount * sizeof(int));
+    unsigned int seed = 2654435761u * (unsigned int) (worker->connectionIndex + 1);
+    double start;
+
+    worker->isFailed = connection < 0;
+    for (operation = 0; operation < worker->requests && !worker->isFailed; operation++)
+    {
+        // Pick one of our processes, and whether it gives back what we got for it or asks for more
+        ownedIndex = (int) (NextRandom(&seed) % (unsigned int) ownedCount);
+        processIndex = worker->connectionIndex + worker->connectionCount * ownedIndex;
+        isRelease = NextRandom(&seed) % 2 == 0;
+        for (resourceIndex = 0; resourceIndex < worker->resourceCount; resourceIndex++)
+        {
+            vector[resourceIndex] = isRelease ? held[ownedIndex * worker->resourceCount + resourceIndex]
+                                              : (int) (NextRandom(&seed) % 2);
+        }
+
+        // Time the round trip
+        start = NowSeconds();
+        result = DaemonRoundTrip(connection, isRelease ? DAEMON_OP_RELEASE : DAEMON_OP_REQUEST, processIndex,
+                                 vector, worker->resourceCount, message);
+        worker->latencies[operation] = NowSeconds() - start;
+        if (result < REQUEST_GRANTED || result > REQUEST_LAST)
+        {
+            worker->isFailed = 1;
+            break;
+        }
+        worker->outcomes[result]++;
+
+        // Track what our processes were granted
+        for (resourceIndex = 0; resourceIndex < worker->resourceCount && result == REQUEST_GRANTED; resourceIndex++)
+        {
+            held[ownedIndex * worker->resourceCount + resourceIndex] += isRelease ? -vector[resourceIndex] : vector[resourceIndex];
+        }
+    }
+    worker->requests = operation;
+
+    // Hand back everything still held
+    for (ownedIndex = 0; ownedIndex < ownedCount && !worker->isFailed; ownedIndex++)
+    {
+        DaemonRoundTrip(connection, DAEMON_OP_RELEASE, worker->connectionIndex + worker->connectionCount * ownedIndex,
+                        held + ownedIndex * worker->resourceCount, worker->resourceCount, message);
+    }
+
+    if (connection >= 0) close(connection);
+    free(held);
+    free(vector);
+    free(message);
+    return NULL;
+}
+
+void RunDaemonClient(const char* path, int connectionCount, int requests)
+{
+    // Drives the daemon from several connections at once and reports requests per second and latency.
+    // Declare variables
+    int connection;
+    int connectionIndex;
+    int result;
+    int reply[3];
+    long long total = 0;
+    long long outcomes[REQUEST_LAST + 1] = { 0 };
+    double* latencies;
+    double start;
+    double elapsed;
+    struct DaemonHeader header = { DAEMON_OP_DESCRIBE, 0, 0 };
+    struct DaemonLoadWorker* workers;
+
+    // Ask the daemon how big its state is
+    connection = ConnectDaemon(path);
+    if (connection < 0 || !WriteAll(connection, &header, sizeof(header)) || !ReadAll(connection, reply, sizeof(reply)))
+    {
+        printf("ERROR: Could not reach the daemon on %s!\n", path);
+        if (connection >= 0) close(connection);
+        return;
+    }
+    close(connection);
+    if (connectionCount < 1) connectionCount = 1;
+    if (connectionCount > reply[1]) connectionCount = reply[1];
+    if (requests < 1) requests = 1;
+    printf("%d connection(s) x %d requests against %d processes x %d resources\n",
+           connectionCount, requests, reply[1], reply[2]);
 
-    } while (anyCompleted);
+    // Run every connection at once
+    workers = calloc(connectionCount, sizeof(struct DaemonLoadWorker));
+    latencies = malloc((size_t) connectionCount * requests * sizeof(double));
+    start = NowSeconds();
+    for (connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+    {
+        workers[connectionIndex].path = path;
+        workers[connectionIndex].connectionIndex = connectionIndex;
+        workers[connectionIndex].connectionCount = connectionCount;
+        workers[connectionIndex].requests = requests;
+        workers[connectionIndex].processCount = reply[1];
+        workers[connectionIndex].resourceCount = reply[2];
+        workers[connectionIndex].latencies = latencies + (size_t) connectionIndex * requests;
+        pthread_create(&workers[connectionIndex].thread, NULL, DaemonLoadWorkerMain, &workers[connectionIndex]);
+    }
+    for (connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
+    {
+        pthread_join(workers[connectionIndex].thread, NULL);
+    }
+    elapsed = NowSeconds() - start;
 
-    if (!allCompleted)
+    // Gather the finished round trips, packing their latencies together
+    for (connectionIndex = 0; connectionIndex < connectionCount; connectionIndex++)
     {
-        // Print could not find safe sequence?
-        printf("\nDeadlock reached!");
+        memmove(latencies + total, workers[connectionIndex].latencies, workers[connectionIndex].requests * sizeof(double));
+        total += workers[connectionIndex].requests;
+        for (result = 0; result <= REQUEST_LAST; result++) outcomes[result] += workers[connectionIndex].outcomes[result];
+        if (workers[connectionIndex].isFailed) printf("Connection %d broke off early\n", connectionIndex);
+    }
+    if (total > 0)
+    {
+        qsort(latencies, (size_t) total, sizeof(double), CompareDouble);
+        printf("\nThroughput: %.0f requests/sec (%.3f s)\n", total / elapsed, elapsed);
+        printf("Latency (us): p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", latencies[total / 2] * 1e6,
+               latencies[total * 99 / 100] * 1e6, latencies[total * 999 / 1000] * 1e6, latencies[total - 1] * 1e6);
+        for (result = 0; result <= REQUEST_LAST; result++)
+        {
+            printf("%-10lld %s\n", outcomes[result], requestMessages[result]);
+        }
     }
+
+    free(latencies);
+    free(workers);
 }
 
 void Quit()
 {
-    // Free all used memory
-    free(resources);
-    free(available);
-    free(maxClaim);
-    free(allocated);
-    free(needed);
+    // Leave a checkpoint behind, then free all used memory
+    ClosePersistence();
+    FreeState();
+    free(report.data);
+    report.data = NULL;
+    report.capacity = 0;
     printf("\nQuitting program...");
 }
 
 /***************************************************************/
-int main() {
+int main(int argc, char** argv) {
     int userInput = 0;
+    unsigned long long sequenceTargets = 0;
+
+    // Keep the state in a directory (recovering it from there) if asked to, then read the rest of the options
+    if (argc >= 3 && strcmp(argv[1], "--persist") == 0)
+    {
+        if (!OpenPersistence(argv[2]) && !persistence.isOpen) return 1;
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // Run the scaling benchmark instead of the menu if asked to
+    if (argc >= 4 && strcmp(argv[1], "--scaling") == 0)
+    {
+        RunScalingBenchmark(atoi(argv[2]), atoi(argv[3]), argc >= 5 ? atoi(argv[4]) : 0);
+        return 0;
+    }
+    // Run the benchmark suite instead of the menu if asked to
+    if (argc >= 4 && strcmp(argv[1], "--bench") == 0)
+    {
+        RunBenchmarkSuite(atoi(argv[2]), atoi(argv[3]), argc >= 5 ? atof(argv[4]) : 1.0, argc >= 6 ? atoi(argv[5]) : 3);
+        return 0;
+    }
+    // Run the resource manager stress test instead of the menu if asked to
+    if (argc >= 4 && strcmp(argv[1], "--stress") == 0)
+    {
+        RunStressBenchmark(atoi(argv[2]), atoi(argv[3]), argc >= 5 ? atoi(argv[4]) : 256, argc >= 6 ? atoi(argv[5]) : 8);
+        return 0;
+    }
+    // Serve requests over a Unix socket if asked to
+    if (argc >= 3 && strcmp(argv[1], "--daemon") == 0)
+    {
+        RunDaemon(argv[2], argc >= 4 ? argv[3] : NULL);
+        return 0;
+    }
+    // Load test a running daemon if asked to
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0)
+    {
+        RunDaemonClient(argv[2], argc >= 4 ? atoi(argv[3]) : 8, argc >= 5 ? atoi(argv[4]) : 10000);
+        return 0;
+    }
+    // Dump every solver's counters for a state file if asked to
+    if (argc >= 3 && strcmp(argv[1], "--stats") == 0)
+    {
+        DumpStateFileStats(argv[2], argc >= 4 ? atoi(argv[3]) : 1);
+        return 0;
+    }
+    // Check the solvers agree with each other if asked to
+    if (argc >= 2 && strcmp(argv[1], "--selftest") == 0)
+    {
+        return RunSolverSelfTest(argc >= 3 ? atoi(argv[2]) : 300) > 0;
+    }
+    // Count and search the safe sequences of a state file if asked to
+    if (argc >= 3 && strcmp(argv[1], "--sequences") == 0)
+    {
+        if (!LoadStateFile(argv[2])) return 1;
+        for (userInput = 4; userInput < argc; userInput++)
+        {
+            if (atoi(argv[userInput]) >= 0 && atoi(argv[userInput]) < SEARCH_PROCESS_LIMIT)
+                sequenceTargets |= 1ULL << atoi(argv[userInput]);
+        }
+        AnalyseSafeSequences(sequenceTargets, argc >= 4 ? atoll(argv[3]) : 0);
+        printf("\n");
+        FreeState();
+        return 0;
+    }
+    // Convert a state file to the binary form if asked to
+    if (argc >= 4 && strcmp(argv[1], "--convert") == 0)
+    {
+        if (!LoadStateFile(argv[2]) || !SaveStateFile(argv[3])) return 1;
+        FreeState();
+        return 0;
+    }
+    // Check a sparse state file if asked to
+    if (argc >= 3 && strcmp(argv[1], "--sparse") == 0)
+    {
+        SolveSparseStateFile(argv[2]);
+        return 0;
+    }
+    // Start from a state file if one was given
+    if (argc >= 3 && strcmp(argv[1], "--load") == 0 && LoadStateFile(argv[2]))
+    {
+        printf("Loaded %d processes x %d resources.\n", processCount, resourceCount);
+        CheckpointState();
+    }
 
-    while (userInput != 3)
+    while (userInput != 14)
     {
         // Take user input for menu option
         printf("\n\n\nBanker's Algorithm\n"
                "------------------\n"
                "1) Enter parameters\n"
                "2) Determine safe sequence\n"
-               "3) Quit program\n"
+               "3) Select solver\n"
+               "4) Request resources\n"
+               "5) Release resources\n"
+               "6) Evaluate what-if scenarios\n"
+               "7) Load state from file\n"
+               "8) Set report verbosity\n"
+               "9) Enter outstanding request\n"
+               "10) Detect deadlock\n"
+               "11) Show solver statistics\n"
+               "12) Count and search safe sequences\n"
+               "13) Change processes or resource types in place\n"
+               "14) Quit program\n"
                "\n"
                "Enter selection: ");
         scanf("%d", &userInput);
@@ -449,11 +5222,46 @@ int main() {
         {
             case 1: // The user is trying to set parameters
                 TakeParameters();
+                CheckpointState();
                 break;
             case 2: // The user is trying to find the safe sequence
                 FindSafeSequence();
                 break;
-            case 3: // The user is trying to quit
+            case 3: // The user is trying to change the solver
+                TakeSolverMode();
+                break;
+            case 4: // The user is trying to request resources for a process
+                TakeRequest(0);
+                break;
+            case 5: // The user is trying to release resources from a process
+                TakeRequest(1);
+                break;
+            case 6: // The user is trying to evaluate hypothetical changes
+                TakeScenarios();
+                break;
+            case 7: // The user is trying to load a state file
+                TakeStateFile();
+                CheckpointState();
+                break;
+            case 8: // The user is trying to change how much is reported
+                TakeVerbosity();
+                break;
+            case 9: // The user is trying to record what a process is blocked waiting for
+                TakeOutstandingRequest();
+                break;
+            case 10: // The user is trying to find deadlocked processes
+                PrintDeadlock();
+                break;
+            case 11: // The user is trying to see what the solvers have cost
+                PrintSolverStats();
+                break;
+            case 12: // The user is trying to explore every safe order
+                TakeSequenceAnalysis();
+                break;
+            case 13: // The user is trying to add, remove or update a process or add a resource type
+                TakeStateChange();
+                break;
+            case 14: // The user is trying to quit
                 Quit();
                 break;
             default: // The user is trying to do something unsupported
@@ -16,6 +16,14 @@ struct LinkedList// A list of all currently-allocated blocks of memory
     struct LinkedList* next;
 };
 
+struct IntervalNode // A node of the AVL tree indexing every block and hole by addressStart
+{
+    struct LinkedList* entry; // The block or hole (holes have an id of -1)
+    struct IntervalNode* left; // Entries that start earlier
+    struct IntervalNode* right; // Entries that start later
+    int height;
+};
+
 // Global Variables
 int pm_size; // Size of physical memory
 int pm_allocated; // Amount of physical memory in use
@@ -23,6 +31,7 @@ int holeFillingAlgorithm; // Hole fitting algorithm chosen (0 = first, 1 = best)
 struct LinkedList* allocations; // All allocations made thus far
 struct LinkedList* allocationsLast; // The back/last allocation in the list
 struct LinkedList* holes; // All the holes available currently
+struct IntervalNode* addressIndex; // Every block and hole, so the one at an address is found in O(log n)
 
 /********************************************************************/
 void DeallocateLinkedList(struct LinkedList *node)
@@ -39,6 +48,184 @@ void DeallocateLinkedList(struct LinkedList *node)
     return;
 }
 /********************************************************************/
+// Blocks and holes never overlap, so ordering them by addressStart is enough to find the one holding an
+// address: it's the last entry starting at or before it, provided it ends after it.
+int IntervalHeight(struct IntervalNode* node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+void UpdateIntervalHeight(struct IntervalNode* node)
+{
+    // Declare variables
+    int leftHeight = IntervalHeight(node->left);
+    int rightHeight = IntervalHeight(node->right);
+
+    node->height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+}
+
+struct IntervalNode* RotateIntervalLeft(struct IntervalNode* node)
+{
+    // Declare variables
+    struct IntervalNode* newRoot = node->right;
+
+    // Lift the right child above this node
+    node->right = newRoot->left;
+    newRoot->left = node;
+    UpdateIntervalHeight(node);
+    UpdateIntervalHeight(newRoot);
+
+    return newRoot;
+}
+
+struct IntervalNode* RotateIntervalRight(struct IntervalNode* node)
+{
+    // Declare variables
+    struct IntervalNode* newRoot = node->left;
+
+    // Lift the left child above this node
+    node->left = newRoot->right;
+    newRoot->right = node;
+    UpdateIntervalHeight(node);
+    UpdateIntervalHeight(newRoot);
+
+    return newRoot;
+}
+
+struct IntervalNode* RebalanceInterval(struct IntervalNode* node)
+{
+    // Declare variables
+    int balance;
+
+    UpdateIntervalHeight(node);
+    balance = IntervalHeight(node->left) - IntervalHeight(node->right);
+
+    // Check if the left side is too tall
+    if (balance > 1)
+    {
+        if (IntervalHeight(node->left->left) < IntervalHeight(node->left->right)) node->left = RotateIntervalLeft(node->left);
+        return RotateIntervalRight(node);
+    }
+    // Check if the right side is too tall
+    if (balance < -1)
+    {
+        if (IntervalHeight(node->right->right) < IntervalHeight(node->right->left)) node->right = RotateIntervalRight(node->right);
+        return RotateIntervalLeft(node);
+    }
+
+    return node;
+}
+
+struct IntervalNode* IndexInterval(struct IntervalNode* node, struct LinkedList* entry)
+{
+    // Adds the entry below node, returning the (possibly new) root of that subtree
+    // Create the node once we've found its place
+    if (node == NULL)
+    {
+        node = malloc(sizeof(struct IntervalNode));
+        node->entry = entry;
+        node->left = NULL;
+        node->right = NULL;
+        node->height = 1;
+        return node;
+    }
+
+    // Descend towards where it belongs
+    if (entry->block.addressStart < node->entry->block.addressStart) node->left = IndexInterval(node->left, entry);
+    else node->right = IndexInterval(node->right, entry);
+
+    return RebalanceInterval(node);
+}
+
+struct IntervalNode* UnindexInterval(struct IntervalNode* node, int addressStart)
+{
+    // Removes the entry starting at addressStart below node, returning the (possibly new) root of that subtree
+    // Declare variables
+    struct IntervalNode* successor;
+
+    // Return on a missing entry
+    if (node == NULL) return NULL;
+
+    // Descend towards the entry
+    if (addressStart < node->entry->block.addressStart) node->left = UnindexInterval(node->left, addressStart);
+    else if (addressStart > node->entry->block.addressStart) node->right = UnindexInterval(node->right, addressStart);
+    // Check if a child can take this node's place outright
+    else if (node->left == NULL || node->right == NULL)
+    {
+        successor = node->left != NULL ? node->left : node->right;
+        free(node);
+        return successor;
+    }
+    // Otherwise, take over the next entry along and remove that one instead
+    else
+    {
+        successor = node->right;
+        while (successor->left != NULL) successor = successor->left;
+        node->entry = successor->entry;
+        node->right = UnindexInterval(node->right, successor->entry->block.addressStart);
+    }
+
+    return RebalanceInterval(node);
+}
+
+void DeallocateIntervalIndex(struct IntervalNode* node)
+{
+    // Return on the null element
+    if (node == NULL) return;
+
+    // Deallocate both children, then this node
+    DeallocateIntervalIndex(node->left);
+    DeallocateIntervalIndex(node->right);
+    free(node);
+}
+
+struct LinkedList* FindAddressOwner(int address)
+{
+    // Returns the block or hole containing address, or NULL if it's outside physical memory
+    // Declare variables
+    struct IntervalNode* node = addressIndex;
+    struct LinkedList* candidate = NULL;
+
+    // Find the last entry starting at or before the address
+    while (node != NULL)
+    {
+        if (node->entry->block.addressStart <= address)
+        {
+            candidate = node->entry;
+            node = node->right;
+        }
+        else node = node->left;
+    }
+
+    // Check it actually reaches the address
+    if (candidate != NULL && address < candidate->block.addressEnd) return candidate;
+    return NULL;
+}
+
+int ListAddressRange(struct IntervalNode* node, int addressStart, int addressEnd)
+{
+    // Prints every entry below node overlapping [addressStart, addressEnd) in address order; returns how many
+    // Declare variables
+    int listed = 0;
+
+    // Return on the null element
+    if (node == NULL) return 0;
+
+    // Entries to the left end before this one starts, so they can only overlap if this starts after addressStart
+    if (node->entry->block.addressStart > addressStart) listed += ListAddressRange(node->left, addressStart, addressEnd);
+    // Print this entry if it overlaps
+    if (node->entry->block.addressStart < addressEnd && node->entry->block.addressEnd > addressStart)
+    {
+        if (node->entry->block.id == -1) printf("hole\t%d\t%d\n", node->entry->block.addressStart, node->entry->block.addressEnd);
+        else printf("%d\t%d\t%d\n", node->entry->block.id, node->entry->block.addressStart, node->entry->block.addressEnd);
+        listed++;
+    }
+    // Entries to the right start after this one ends, so they can only overlap if this ends before addressEnd
+    if (node->entry->block.addressEnd < addressEnd) listed += ListAddressRange(node->right, addressStart, addressEnd);
+
+    return listed;
+}
+/********************************************************************/
 void TakeParameters() {
     // Declare variables
     int isInputBad;
@@ -83,15 +270,25 @@ void TakeParameters() {
         fflush(stdin);
     } while (isInputBad);
 
+    // Release any previously entered memory layout
+    DeallocateLinkedList(holes);
+    DeallocateLinkedList(allocations);
+    DeallocateIntervalIndex(addressIndex);
+    allocations = NULL;
+    allocationsLast = NULL;
+
     // Default the allocated physical memory to 0
     pm_allocated = 0;
     // Initialize the LinkedList for holes
     holes = malloc(sizeof(struct LinkedList));
     // Default the size to be the entirety of the physical memory
+    holes->block.id = -1;
     holes->block.addressStart = 0;
     holes->block.addressEnd = pm_size;
     holes->next = NULL;
     holes->last = NULL;
+    // Index the one hole
+    addressIndex = IndexInterval(NULL, holes);
 }
 /********************************************************************/
 void PrintAllocationTable() {
@@ -189,9 +386,13 @@ void AllocateBlockHelper(int id, int size, struct LinkedList* filledHole)
     // Update the amount of used memory
     pm_allocated += size;
 
+    // Swap the hole for the block in the address index (they start at the same address)
+    addressIndex = UnindexInterval(addressIndex, filledHole->block.addressStart);
+    addressIndex = IndexInterval(addressIndex, newBlock);
+
     // Update/Remove the Hole
     // Check if the hole has been filled fully
-     if (allocationsLast->block.addressEnd == filledHole->block.addressEnd)
+    if (newBlock->block.addressEnd == filledHole->block.addressEnd)
     {
         // Remove the hole entirely
         // Check if we're at the front of the list
@@ -200,12 +401,18 @@ void AllocateBlockHelper(int id, int size, struct LinkedList* filledHole)
             // Move the hole pointer forward, potentially null-ing it!
             holes = holes->next;
         }
+        // Unlink the hole from its neighbours
+        if (filledHole->last != NULL) filledHole->last->next = filledHole->next;
+        if (filledHole->next != NULL) filledHole->next->last = filledHole->last;
+        // Destroy the filled hole
+        free(filledHole);
     }
     // Otherwise, fill part of the hole
     else
     {
-        // Move the start of the hole forward to just after the block
+        // Move the start of the hole forward to just after the block, and index it there
         filledHole->block.addressStart = newBlock->block.addressEnd;
+        addressIndex = IndexInterval(addressIndex, filledHole);
     }
 }
 void TakeAllocateBlock() {
@@ -418,6 +625,7 @@ void TakeDeallocateBlock() {
 
     // Create the new hole
     newHole = malloc(sizeof(struct LinkedList));
+    newHole->block.id = -1;
     newHole->block.addressStart = removedBlock->block.addressStart;
     newHole->block.addressEnd = removedBlock->block.addressEnd;
     newHole->next = NULL;
@@ -475,12 +683,13 @@ void TakeDeallocateBlock() {
         }
     }
 
+    // Swap the block for the hole in the address index (they start at the same address)
+    addressIndex = UnindexInterval(addressIndex, removedBlock->block.addressStart);
+    addressIndex = IndexInterval(addressIndex, newHole);
+
     // Adjust the pointers
-    if (removedBlock == allocations)
-    {
-        if (removedBlock->last != NULL) allocations = removedBlock->last;
-        else if (removedBlock->next != NULL) allocations = removedBlock->next;
-    }
+    if (removedBlock == allocations) allocations = removedBlock->next;
+    if (removedBlock == allocationsLast) allocationsLast = removedBlock->last;
     // Adjust the pointers between the left and right
     if (removedBlock->next != NULL) removedBlock->next->last = removedBlock->last;
     if (removedBlock->last != NULL) removedBlock->last->next = removedBlock->next;
@@ -506,9 +715,10 @@ void TakeDeallocateBlock() {
 
             // Update the pointers
             currentHole->next = currentHole->next->next;
-            currentHole->next->last = currentHole;
+            if (currentHole->next != NULL) currentHole->next->last = currentHole;
 
-            // Destroy the merged hole
+            // Destroy the merged hole, dropping it from the address index
+            addressIndex = UnindexInterval(addressIndex, removedHole->block.addressStart);
             free(removedHole);
         }
 
@@ -527,6 +737,10 @@ void DefragmentMemory() {
     struct LinkedList* currentBlock;
     int currentBlockSize;
 
+    // Drop the address index, as every address is about to change
+    DeallocateIntervalIndex(addressIndex);
+    addressIndex = NULL;
+
     // Move all allocations to be next to one-another
     // Loop over each block
     currentBlock = allocations;
@@ -550,6 +764,8 @@ void DefragmentMemory() {
             // Update the end of the memory
             currentBlock->block.addressEnd = currentBlock->block.addressStart + currentBlockSize;
         }
+        // Index the block at its new address
+        addressIndex = IndexInterval(addressIndex, currentBlock);
 
         // Enumerate forward on the list
         currentBlock = currentBlock->next;
@@ -557,17 +773,21 @@ void DefragmentMemory() {
 
     // Remove all holes
     DeallocateLinkedList(holes);
+    holes = NULL;
     // Check if there's room for a hole at the end of memory
-    if (allocationsLast->block.addressEnd < pm_size)
+    if (pm_allocated < pm_size)
     {
         // Create a new hole to place in the gap
         holes = malloc(sizeof(struct LinkedList));
         // Configure the hole
-        holes->block.addressStart = allocationsLast->block.addressEnd;
+        holes->block.id = -1;
+        holes->block.addressStart = pm_allocated;
         holes->block.addressEnd = pm_size;
         // Set the pointers to null
         holes->next = NULL;
         holes->last = NULL;
+        // Index the hole
+        addressIndex = IndexInterval(addressIndex, holes);
     }
 
     // Print the allocation table
@@ -576,17 +796,54 @@ void DefragmentMemory() {
     return;
 }
 /********************************************************************/
+void TakeAddressLookup() {
+    // Declare variables
+    struct LinkedList* owner;
+    int address;
+
+    // Take the address
+    printf("Enter address: ");
+    scanf("%d", &address);
+    // Clear the input
+    fflush(stdin);
+
+    // Find and print whatever holds it
+    owner = FindAddressOwner(address);
+    if (owner == NULL) printf("\nAddress %d is outside physical memory.\n", address);
+    else if (owner->block.id == -1)
+        printf("\nAddress %d is in the hole from %d to %d.\n", address, owner->block.addressStart, owner->block.addressEnd);
+    else
+        printf("\nAddress %d is in block %d (%d to %d).\n", address, owner->block.id, owner->block.addressStart, owner->block.addressEnd);
+}
+
+void TakeRangeLookup() {
+    // Declare variables
+    int addressStart;
+    int addressEnd;
+
+    // Take the range
+    printf("Enter start and end address: ");
+    scanf("%d %d", &addressStart, &addressEnd);
+    // Clear the input
+    fflush(stdin);
+
+    // Print the table header, then every block and hole overlapping the range
+    printf("\nID\tStart\tEnd\n-------------------\n");
+    if (ListAddressRange(addressIndex, addressStart, addressEnd) == 0) printf("Nothing in that range.\n");
+}
+/********************************************************************/
 void Quit()
 {
     // Deallocate linked list (if null)
     DeallocateLinkedList(holes);
     DeallocateLinkedList(allocations);
+    DeallocateIntervalIndex(addressIndex);
 }
 /***************************************************************/
 int main() {
     int userInput = 0;
 
-    while (userInput != 5)
+    while (userInput != 7)
     {
         // Take user input for menu option
         printf("\nMemory allocation\n"
@@ -595,7 +852,9 @@ int main() {
                "2) Allocate memory for block\n"
                "3) Deallocate memory for block\n"
                "4) Defragment memory\n"
-               "5) Quit program\n"
+               "5) Find block at address\n"
+               "6) List blocks in address range\n"
+               "7) Quit program\n"
                "\n"
                "Enter selection: ");
         scanf("%d", &userInput);
@@ -615,7 +874,13 @@ int main() {
             case 4: // The user is trying to defragment memory
                 DefragmentMemory();
                 break;
-            case 5: // The user is trying to quit
+            case 5: // The user is trying to find what holds an address
+                TakeAddressLookup();
+                break;
+            case 6: // The user is trying to see what lies in a range of addresses
+                TakeRangeLookup();
+                break;
+            case 7: // The user is trying to quit
                 Quit();
                 break;
             default: // The user is trying to do something unsupported